@@ -9,11 +9,16 @@
  */
 
 #include "lightwareSF40.h"
+#include "lightwareSF40Transport.h"
+#include "lightwareSF40CRC.h"
+#include "lightwareSF40Simd.h"
 #include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
 
 
-device_t lidarCOM;
-
 typedef struct flags{
 	union{
 		uint16_t sr;
@@ -25,209 +30,880 @@ typedef struct flags{
 	};
 }flag_t;
 
-/*! \brief Calculate checksum for lidar data
+/*! \brief Receive ring buffer, filled in large chunks from the serial port
+ *
+ *  \details head and tail are free running byte counters, the position in data is found by masking.
+ */
+typedef struct{
+	uint8_t  data[RX_BUFFER_SIZE];
+	uint32_t head;		// Total number of bytes written into the buffer
+	uint32_t tail;		// Total number of bytes consumed from the buffer
+}rxBuffer_t;
+
+// States of the packet parser, a packet is build up as: start byte, 2 header bytes, payload, 2 checksum bytes
+typedef enum{
+	PARSE_SYNC,			// Looking for the start byte
+	PARSE_HEADER,		// Receiving the header with the payload length
+	PARSE_PAYLOAD,		// Receiving the payload
+	PARSE_CRC,			// Receiving the checksum
+	PARSE_DONE			// A complete packet is in the frame, it stays there until the next call
+}parseState_t;
+
+/*! \brief Packet parser state, keeps a partially received packet between calls
+ */
+typedef struct{
+	parseState_t state;
+	uint16_t     received;					// Number of bytes of the current packet saved in frame
+	uint16_t     expected;					// Number of bytes frame has to hold before the next state
+	uint16_t     pay_len;					// Payload length from the header of the current packet
+	sf40Crc_t    crc;						// Checksum of the first checked bytes of frame
+	uint16_t     checked;					// Number of bytes of frame that are in crc
+	uint8_t      frame[MAX_RESPONSE_SIZE];	// Packet that is being received
+}parser_t;
+
+/*! \brief Bounded single producer / single consumer queue of received stream packets
+ *
+ *  \details The reader thread only writes head, the consumer only writes tail.
+ *           Both are on their own cache line so the two threads don't keep stealing it from each other.
+ *           Packets are kept as received, they are only decoded when the consumer asks for it.
+ */
+typedef struct{
+	_Alignas(CACHE_LINE_SIZE) atomic_uint head;		// Total number of packets pushed
+	atomic_uint highWater;							// Highest number of packets that were waiting in the queue
+	atomic_uint dropped;							// Packets dropped because the queue was full
+	_Alignas(CACHE_LINE_SIZE) atomic_uint tail;		// Total number of packets popped
+	_Alignas(CACHE_LINE_SIZE) uint8_t packets[STREAM_QUEUE_SIZE][MAX_RESPONSE_SIZE];
+}streamQueue_t;
+
+/*! \brief Counters of packets that didn't make it and the position the next stream packet should start at
+ *
+ *  \details Only whoever receives the packets writes here, the counters are atomic so they can be read at any time.
+ */
+typedef struct{
+	atomic_uint crcErrors;			// Packets with a checksum that didn't match
+	atomic_uint lengthErrors;		// Packets with a length that can't be right
+	atomic_uint lostPoints;			// Stream points that never made it into the queue
+	atomic_uint lostRevolutions;	// Revolutions of which not a single packet made it into the queue
+	bool        tracking;			// true when the fields below hold the position after the last stream packet
+	uint8_t     revolutionIndex;	// Revolution of the last stream packet
+	uint16_t    pointTotal;			// Points in the revolution of the last stream packet
+	uint16_t    nextIndex;			// Point index right after the last stream packet
+}streamLoss_t;
+
+/*! \brief Library owned thread that receives and decodes the stream
+ */
+typedef struct{
+	pthread_t     thread;
+	atomic_bool   running;
+	streamQueue_t queue;
+	streamLoss_t  loss;
+}streamReader_t;
+
+
+/*! \brief Handler for changes of the alarm state in the stream, and the state it was last told about
+ */
+typedef struct{
+	sf40AlarmHandler_t handler;	// Called when the alarm state changes, NULL when nobody listens
+	void*              user;		// Passed to handler
+	uint8_t            last;		// Alarm state of the previous stream packet
+}alarmWatch_t;
+
+/*! \brief Everything needed to drive one lidar, so several can be used at the same time
+ */
+struct sf40{
+	sf40Transport_t* transport;	// Connection to the lidar
+	rxBuffer_t     rxBuffer;
+	parser_t       parser;
+	streamReader_t reader;
+	lidarCommand_t* pending[256];	// Command waiting for a response, for every command number
+	pthread_mutex_t lock;			// Protects pending and the result of the commands in it
+	pthread_cond_t  responded;		// Signalled when the reader thread has handed out a response
+	alarmWatch_t    alarms;			// Protected by lock
+};
+
+// Lidar used by the functions without a handle, its lock and condition are made once and never destroyed
+static sf40_t defaultLidar;
+static pthread_once_t defaultLidarOnce = PTHREAD_ONCE_INIT;
+
+
+/*! \brief Number of received bytes that have not been consumed yet
+ */
+static inline uint32_t rxAvailable(sf40_t* lidar){
+	return lidar->rxBuffer.head - lidar->rxBuffer.tail;
+}/*rxAvailable*/
+
+
+/*! \brief Drop everything that has been received so far
+ */
+static void rxFlush(sf40_t* lidar){
+	if(lidar->transport != NULL) lidar->transport->flush(lidar->transport);
+	lidar->rxBuffer.tail = lidar->rxBuffer.head;
+	lidar->parser.state = PARSE_SYNC;
+}/*rxFlush*/
+
+
+/*! \brief Move the bytes that have arrived into the receive buffer
+ *  
+ *  \retval Amount of bytes added to the receive buffer.
+ *  \retval -1 : reading from the lidar has failed.
+ * 
+ *  \details Everything is read with a single call to the transport,
+ *           the second io vector is used when the free space wraps around the end of the buffer.
+ */
+static int rxFill(sf40_t* lidar){
+	if(lidar->transport == NULL) return -1;
+
+	uint32_t space = RX_BUFFER_SIZE - rxAvailable(lidar);
+	if(space == 0) return 0;
+
+	uint32_t start = lidar->rxBuffer.head & (RX_BUFFER_SIZE - 1);
+	uint32_t first = RX_BUFFER_SIZE - start;
+	if(first > space) first = space;
+
+	struct iovec chunks[2];
+	chunks[0].iov_base = &lidar->rxBuffer.data[start];
+	chunks[0].iov_len  = first;
+	chunks[1].iov_base = &lidar->rxBuffer.data[0];
+	chunks[1].iov_len  = space - first;
+
+	ssize_t received = lidar->transport->read(lidar->transport, chunks, (space > first) ? 2 : 1);
+	if(received < 0) return -1;
+
+	lidar->rxBuffer.head += received;
+	return received;
+}/*rxFill*/
+
+
+/*! \brief Take the bytes that have already arrived out of the receive buffer
  *  
- *  \param Data Data that has been received / is going to be send to the lidar
+ *  \param data location where the bytes need to be saved
  * 
- *  \param Size Number of bytes in package
+ *  \param maximum maximum number of bytes to take
+ *  
+ *  \return Amount of bytes that have been copied
+ */
+static uint16_t rxTake(sf40_t* lidar, uint8_t* data, uint16_t maximum){
+	uint32_t size = rxAvailable(lidar);
+	if(size > maximum) size = maximum;
+
+	uint32_t start = lidar->rxBuffer.tail & (RX_BUFFER_SIZE - 1);
+	uint32_t first = RX_BUFFER_SIZE - start;
+	if(first > size) first = size;
+
+	memcpy(data, &lidar->rxBuffer.data[start], first);
+	memcpy(&data[first], &lidar->rxBuffer.data[0], size - first);
+	lidar->rxBuffer.tail += size;
+	return size;
+}/*rxTake*/
+
+
+/*! \brief Start a new packet in the parser
+ *  
+ *  \param received number of bytes of the packet that are already in the frame
+ */
+static void parserStart(sf40_t* lidar, uint16_t received){
+	lidar->parser.received = received;
+	lidar->parser.expected = 3;
+	lidar->parser.checked = 0;
+	sf40CrcInit(&lidar->parser.crc);
+	lidar->parser.state = PARSE_HEADER;
+}/*parserStart*/
+
+
+/*! \brief Take bytes out of the receive buffer until the parser has the amount it expects
+ *  
+ *  \return true when the expected amount of bytes is in the frame
  * 
- *  \return returns 2 byte checksum
+ *  \details The checksum is updated with every new byte before the checksum bytes themselves,
+ *           so it is ready as soon as the packet is complete.
  */
-uint16_t createCRC(uint8_t* data, uint16_t size){
-    uint16_t crc = 0;
-        for(uint32_t i = 0; i < size; ++i){
-            uint16_t code = crc >> 8;
-            code ^= data[i];
-            code ^= code >> 4;
-            crc = crc << 8;
-            crc ^= code;
-            code = code << 5;
-            crc ^= code;
-            code = code << 7;
-            crc ^= code;
-        }
-    return crc;
-} /*createCRC*/
+static bool parserFill(sf40_t* lidar){
+	parser_t* parser = &lidar->parser;
+	if(parser->received < parser->expected){
+		parser->received += rxTake(lidar, &parser->frame[parser->received], parser->expected - parser->received);
+	}
+
+	uint16_t end = (parser->state == PARSE_CRC) ? parser->expected - 2 : parser->expected;
+	if(end > parser->received) end = parser->received;
+	if(end > parser->checked){
+		sf40CrcUpdate(&parser->crc, &parser->frame[parser->checked], end - parser->checked);
+		parser->checked = end;
+	}
+	return parser->received >= parser->expected;
+}/*parserFill*/
 
 
-/*! \brief Get a packet form the lidar
+/*! \brief Restart the parser on the next start byte that is already saved in the frame
  *  
- *  \param payload location where payload needs to be saved
+ *  \param from first position in the frame that may hold the next start byte
+ * 
+ *  \details Used after a rejected packet, so a real packet that started inside it isn't lost,
+ *           and after a finished packet to keep bytes that were taken beyond its end.
+ */
+static void parserRestart(sf40_t* lidar, uint16_t from){
+	for(uint16_t i = from; i < lidar->parser.received; i++){
+		if(lidar->parser.frame[i] != STARTBIT) continue;
+
+		memmove(lidar->parser.frame, &lidar->parser.frame[i], lidar->parser.received - i);
+		parserStart(lidar, lidar->parser.received - i);
+		return;
+	}
+	lidar->parser.received = 0;
+	lidar->parser.state = PARSE_SYNC;
+}/*parserRestart*/
+
+
+/*! \brief Get a packet form the lidar without waiting for bytes that haven't arrived yet
+ *  
+ *  \param packet set to the received packet, it stays valid until the next call
  *  
  *  \retval Amount of bytes in data packet.
- *  \retval -1 : first byte doesnt equal the start byte.
+ *  \retval  0 : the packet is not complete yet, the received part is kept for the next call.
+ *  \retval -1 : reading from the serial port has failed.
  *  \retval -2 : the received datapacket is either to small or to large.
  *  \retval -3 : checksums didn't match.
  * 
+ *  \details Bytes are parsed as they arrive: sync on the start byte, header, payload and checksum.
  */
-int16_t getPacket(uint8_t *payload){
-	uint16_t crc;
-	flag_t header;
+static int16_t getPacket(sf40_t* lidar, const uint8_t** packet){
+	// keep the bytes that were taken beyond the end of the previous packet
+	if(lidar->parser.state == PARSE_DONE) parserRestart(lidar, lidar->parser.expected);
+
+	if(rxFill(lidar) < 0) return -1;
+
+	while(true){
+		switch(lidar->parser.state){
+			case PARSE_SYNC:
+				// skip everything up to the start byte
+				while(rxAvailable(lidar) && lidar->rxBuffer.data[lidar->rxBuffer.tail & (RX_BUFFER_SIZE - 1)] != STARTBIT){
+					lidar->rxBuffer.tail++;
+				}
+				if(!rxAvailable(lidar)) return 0;
+
+				parserStart(lidar, 0);
+				break;
+
+			case PARSE_HEADER:{
+				if(!parserFill(lidar)) return 0;
+
+				// format the header into the seprate parts
+				flag_t header;
+				header.sr = lidar->parser.frame[1] | (uint16_t)(lidar->parser.frame[2] << 8);
+				if(header.pay_len < 1 || header.pay_len > MAX_RESPONSE_SIZE - 5){
+					parserRestart(lidar, 1);
+					return -2;
+				}
+
+				lidar->parser.pay_len = header.pay_len;
+				lidar->parser.expected = 3 + header.pay_len;
+				lidar->parser.state = PARSE_PAYLOAD;
+				break;
+			}
 
-    for(int i = 0; i < 3; i++){
-        readByte(&lidarCOM, &payload[i]);
-    }
+			case PARSE_PAYLOAD:
+				if(!parserFill(lidar)) return 0;
 
-    // format the header into the seprate parts
-    header.sr = payload[1] | (uint16_t)(payload[2] << 8);
+				lidar->parser.expected += 2;
+				lidar->parser.state = PARSE_CRC;
+				break;
 
-    //check if first bit is start bit
-	if(payload[0] != STARTBIT) return -1;
-    if(header.pay_len < 1 || header.pay_len > MAX_RESPONSE_SIZE - 5) return -2;
-	
-	for (int i = 0; i < header.pay_len + 2; i++){
-		readByte(&lidarCOM, &payload[i+3]);
-	}
-	
-	crc = payload[header.pay_len + 3] | (payload[header.pay_len + 4] << 8);
-	if (crc == createCRC(payload, 3 + header.pay_len)){
-		return header.pay_len;
+			case PARSE_CRC:{
+				if(!parserFill(lidar)) return 0;
+
+				uint16_t crc = lidar->parser.frame[lidar->parser.pay_len + 3] | (lidar->parser.frame[lidar->parser.pay_len + 4] << 8);
+				if(crc != sf40CrcFinal(&lidar->parser.crc)){
+					parserRestart(lidar, 1);
+					return -3;
+				}
+
+				*packet = lidar->parser.frame;
+				lidar->parser.state = PARSE_DONE;
+				return lidar->parser.pay_len;
+			}
+
+			case PARSE_DONE:
+				parserRestart(lidar, lidar->parser.expected);
+				break;
+		}
 	}
-	return -3;
 } /*getPacket*/
 
 
-/*! \brief Read data from specific lidar command
+/*! \brief Sleep until the lidar has sent new data
  *  
- *  \param command command that needs to be read from
+ *  \param deadline monotonic time [us] at which to stop waiting
  *  
- *  \param payload location where data needs to be saved
+ *  \retval  1 : data is ready to be read
+ *  \retval  0 : deadline has passed
+ *  \retval -1 : waiting on the lidar has failed
+ */
+static int rxWait(sf40_t* lidar, uint64_t deadline){
+	if(lidar->transport == NULL) return -1;
+
+	uint64_t now = sf40MonotonicTime();
+	if(now >= deadline) return 0;
+
+	return lidar->transport->wait(lidar->transport, deadline - now);
+}/*rxWait*/
+
+
+static void pushStream(sf40_t* lidar, const uint8_t* packet, int16_t length);
+
+/*! \brief Hand a received packet to whoever is waiting for it
  *  
- *  \retval Amount of bytes in data packet.
- *  \retval -1 : if reading from the lidar has failed
+ *  \param packet received packet
+ * 
+ *  \param length payload length of the packet
  * 
+ *  \details A packet goes to the command with the same command number that is waiting for a response,
+ *           and its completion is called. Distance output packets that no command asked for are put
+ *           in the stream queue, every other packet is dropped. When the alarm state in a distance output packet
+ *           differs from the previous one the alarm handler is called first, before the packet is queued.
  */
-int16_t readCommand(uint8_t command, uint8_t* payload){
-	flag_t header;
-	header.pay_len = 1;
-	header.rw = 0;
-	
-	flushBuffer(&lidarCOM);
+static void dispatchPacket(sf40_t* lidar, const uint8_t* packet, int16_t length){
+	sf40Completion_t completion = NULL;
+	void* user = NULL;
+
+	sf40AlarmHandler_t alarmHandler = NULL;
+	void* alarmUser = NULL;
+	alarmEvent_t alarm;
+
+	pthread_mutex_lock(&lidar->lock);
+	lidarCommand_t* command = lidar->pending[packet[3]];
+	if(command == NULL && packet[3] == LIDAR_DISTANCE_OUTPUT && length >= 15){
+		uint8_t state = packet[4];
+		uint8_t changed = state ^ lidar->alarms.last;
+		lidar->alarms.last = state;
+		if(changed && lidar->alarms.handler != NULL){
+			alarmHandler = lidar->alarms.handler;
+			alarmUser = lidar->alarms.user;
+			alarm.state.byte   = state;
+			alarm.rising.byte  = changed & state;
+			alarm.falling.byte = changed & ~state;
+			alarm.timestamp = sf40MonotonicTime();
+			alarm.revolutionIndex = packet[11];
+			alarm.pointStartIndex = (uint16_t)(packet[17]<<8 | packet[16]);
+		}
+	}
+	if(command != NULL){
+		lidar->pending[packet[3]] = NULL;
+		if(command->response != NULL) memcpy(command->response, packet, length + 5);
+		completion = command->completion;
+		user = command->user;
+		command->result = length;
+		pthread_cond_broadcast(&lidar->responded);
+	}
+	pthread_mutex_unlock(&lidar->lock);
+
+	if(completion != NULL) completion(command, user);
+	if(alarmHandler != NULL) alarmHandler(lidar, &alarm, alarmUser);
+	if(command == NULL && packet[3] == LIDAR_DISTANCE_OUTPUT) pushStream(lidar, packet, length);
+}/*dispatchPacket*/
+
+
+/*! \brief Parse and dispatch every packet that has arrived, without waiting for more
+ *  
+ *  \retval  0 : all received packets have been handled
+ *  \retval -1 : reading from the lidar has failed
+ */
+static int pumpPackets(sf40_t* lidar){
+	const uint8_t* packet;
+	while(true){
+		int16_t length = getPacket(lidar, &packet);
+		if(length == 0) return 0;
+		if(length == -1) return -1;
+		if(length == -2) atomic_fetch_add_explicit(&lidar->reader.loss.lengthErrors, 1, memory_order_relaxed);
+		if(length == -3) atomic_fetch_add_explicit(&lidar->reader.loss.crcErrors, 1, memory_order_relaxed);
+		if(length > 0) dispatchPacket(lidar, packet, length);
+	}
+}/*pumpPackets*/
+
+
+/*! \brief Stop waiting for the response on a command and let it fail
+ */
+static void dropPending(sf40_t* lidar, lidarCommand_t* command){
+	sf40Completion_t completion = NULL;
+	void* user = NULL;
+
+	pthread_mutex_lock(&lidar->lock);
+	if(lidar->pending[command->command] == command){
+		lidar->pending[command->command] = NULL;
+		completion = command->completion;
+		user = command->user;
+		command->result = -1;
+	}
+	pthread_mutex_unlock(&lidar->lock);
+
+	if(completion != NULL) completion(command, user);
+}/*dropPending*/
+
+
+/*! \brief Let every command fail that has been waiting longer than COMMAND_TIMEOUT_US
+ */
+static void expireCommands(sf40_t* lidar){
+	uint64_t now = sf40MonotonicTime();
+	lidarCommand_t*  expired[256];
+	sf40Completion_t completions[256];
+	void*            users[256];
+	int count = 0;
+
+	pthread_mutex_lock(&lidar->lock);
+	for(int i = 0; i < 256; i++){
+		lidarCommand_t* command = lidar->pending[i];
+		if(command == NULL || now < command->deadline) continue;
+
+		lidar->pending[i] = NULL;
+		expired[count]     = command;
+		completions[count] = command->completion;
+		users[count]       = command->user;
+		command->result = -1;
+		count++;
+	}
+	if(count > 0) pthread_cond_broadcast(&lidar->responded);
+	pthread_mutex_unlock(&lidar->lock);
+
+	for(int i = 0; i < count; i++){
+		if(completions[i] != NULL) completions[i](expired[i], users[i]);
+	}
+}/*expireCommands*/
+
+
+/*! \brief Build the packet for a lidar command
+ *  
+ *  \param packet location where the packet needs to be saved, must be able to hold 6 + data_len bytes
+ * 
+ *  \param command command that needs to be read from / written to
+ * 
+ *  \param write true to write payload to the command, false to read it
+ * 
+ *  \param payload payload that needs to be send, only used when writing
+ * 
+ *  \param data_len number of bytes in payload
+ *  
+ *  \return Amount of bytes in the packet
+ */
+static uint16_t buildPacket(uint8_t* packet, uint8_t command, bool write, const void* payload, uint16_t data_len){
+	if(!write) data_len = 0;
+
+	flag_t header = { .sr = 0 };
+	header.pay_len = 1 + data_len;
+	header.rw = write;
 
-	uint8_t packet[6];
 	packet[0] = STARTBIT;
 	packet[1] = header.sr;
 	packet[2] = header.sr >> 8;
 	packet[3] = command;
-	packet[4] = createCRC(packet, 4);
-	packet[5] = createCRC(packet, 4) >> 8;
-	
+	if(data_len > 0) memcpy(&packet[4], payload, data_len);
+
+	uint16_t crc = createCRC(packet, 4 + data_len);
+	packet[4 + data_len] = crc;
+	packet[5 + data_len] = crc >> 8;
+	return 6 + data_len;
+}/*buildPacket*/
+
+
+/*! \brief Read requests of every documented command, including their checksum
+ *
+ *  \details A read request only holds the command number, so it never changes. Unlisted
+ *           commands are left zero and build at runtime.
+ */
+static const uint8_t readRequests[256][6] = {
+	[LIDAR_PRODUCT_NAME]     = {STARTBIT, 0x40, 0x00, LIDAR_PRODUCT_NAME,    0x70, 0x9F},
+	[LIDAR_SERIAL_NUMBER]    = {STARTBIT, 0x40, 0x00, LIDAR_SERIAL_NUMBER,   0x13, 0xAF},
+	[LIDAR_USER_DATA]        = {STARTBIT, 0x40, 0x00, LIDAR_USER_DATA,       0x59, 0x0E},
+	[LIDAR_TOKEN]            = {STARTBIT, 0x40, 0x00, LIDAR_TOKEN,           0x3A, 0x3E},
+	[LIDAR_SAVE_PARAMETERS]  = {STARTBIT, 0x40, 0x00, LIDAR_SAVE_PARAMETERS, 0xFC, 0x5E},
+	[LIDAR_RESET]            = {STARTBIT, 0x40, 0x00, LIDAR_RESET,           0xBE, 0x7E},
+	[LIDAR_INCOMING_VOLTAGE] = {STARTBIT, 0x40, 0x00, LIDAR_INCOMING_VOLTAGE,0xC5, 0xCD},
+	[LIDAR_STREAM]           = {STARTBIT, 0x40, 0x00, LIDAR_STREAM,          0x8F, 0x6C},
+	[LIDAR_DISTANCE_OUTPUT]  = {STARTBIT, 0x40, 0x00, LIDAR_DISTANCE_OUTPUT, 0x23, 0xA9},
+	[LIDAR_LASER_FIRING]     = {STARTBIT, 0x40, 0x00, LIDAR_LASER_FIRING,    0x61, 0x89},
+	[LIDAR_TEMPRATURE]       = {STARTBIT, 0x40, 0x00, LIDAR_TEMPRATURE,      0xC4, 0xD9},
+	[LIDAR_BAUD_RATE]        = {STARTBIT, 0x40, 0x00, LIDAR_BAUD_RATE,       0xCF, 0x64},
+	[LIDAR_DISTANCE]         = {STARTBIT, 0x40, 0x00, LIDAR_DISTANCE,        0xFF, 0x62},
+	[LIDAR_MOTOR_STATE]      = {STARTBIT, 0x40, 0x00, LIDAR_MOTOR_STATE,     0x9C, 0x52},
+	[LIDAR_MOTOR_VOLTAGE]    = {STARTBIT, 0x40, 0x00, LIDAR_MOTOR_VOLTAGE,   0xBD, 0x42},
+	[LIDAR_OUTPUT_RATE]      = {STARTBIT, 0x40, 0x00, LIDAR_OUTPUT_RATE,     0x5A, 0x32},
+	[LIDAR_FORWARD_OFFSET]   = {STARTBIT, 0x40, 0x00, LIDAR_FORWARD_OFFSET,  0x7B, 0x22},
+	[LIDAR_REVOLUTIONS]      = {STARTBIT, 0x40, 0x00, LIDAR_REVOLUTIONS,     0x18, 0x12},
+	[LIDAR_ALARM_STATE]      = {STARTBIT, 0x40, 0x00, LIDAR_ALARM_STATE,     0x39, 0x02},
+	[LIDAR_ALARM_1]          = {STARTBIT, 0x40, 0x00, LIDAR_ALARM_1,         0xE7, 0xE1},
+	[LIDAR_ALARM_2]          = {STARTBIT, 0x40, 0x00, LIDAR_ALARM_2,         0xC6, 0xF1},
+	[LIDAR_ALARM_3]          = {STARTBIT, 0x40, 0x00, LIDAR_ALARM_3,         0xA5, 0xC1},
+	[LIDAR_ALARM_4]          = {STARTBIT, 0x40, 0x00, LIDAR_ALARM_4,         0x84, 0xD1},
+	[LIDAR_ALARM_5]          = {STARTBIT, 0x40, 0x00, LIDAR_ALARM_5,         0x63, 0xA1},
+	[LIDAR_ALARM_6]          = {STARTBIT, 0x40, 0x00, LIDAR_ALARM_6,         0x42, 0xB1},
+	[LIDAR_ALARM_7]          = {STARTBIT, 0x40, 0x00, LIDAR_ALARM_7,         0x21, 0x81},
+};
+
+
+/*! \brief Get the packet that reads a command
+ *  
+ *  \param packet location where the packet is build when it isn't in readRequests, must hold 6 bytes
+ * 
+ *  \param command command that needs to be read from
+ * 
+ *  \return 6 byte request, either from readRequests or in packet
+ */
+static const uint8_t* readRequest(uint8_t* packet, uint8_t command){
+	if(readRequests[command][0] == STARTBIT) return readRequests[command];
+
+	buildPacket(packet, command, false, NULL, 0);
+	return packet;
+}/*readRequest*/
+
+
+/*! \brief Send one or more packets to the lidar with a single write
+ *  
+ *  \param packets packets that need to be send, placed right after each other
+ * 
+ *  \param size total number of bytes in packets
+ *  
+ *  \retval  0 : everything has been send
+ *  \retval -1 : writing to the lidar has failed
+ */
+static int sendPackets(sf40_t* lidar, const uint8_t* packets, uint16_t size){
 	#ifdef DEBUG
 	printf("Sending: ");
-	#endif
-	for(int i = 0; i < 6; i++){
-		sendByte(&lidarCOM, packet[i]);
-		#ifdef DEBUG
-		printf("%02x ", packet[i]);
-		#endif
+	for(int i = 0; i < size; i++){
+		printf("%02x ", packets[i]);
 	}
-	#ifdef DEBUG
 	printf("\n");
 	#endif
 
-    uint16_t cycles_Waited = 0;
-    while(true){
-        usleep(10);
-        cycles_Waited++;
+	if(lidar->transport == NULL) return -1;
+
+	struct iovec chunk = { .iov_base = (void*)packets, .iov_len = size };
+	if(lidar->transport->write(lidar->transport, &chunk, 1) != size) return -1;
+	return 0;
+}/*sendPackets*/
+
 
-        //if the wait time is longer then 100ms report it as a not succesfull
-        if(cycles_Waited > 10000){
+/*! \brief Send a command to the lidar without waiting for its response
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param command command that needs to be send, it has to stay valid until its response has been received
+ *  
+ *  \retval  0 : the command has been send, command->result is 0 until its response arrives
+ *  \retval -1 : sending has failed or a response for the same command is still pending
+ * 
+ *  \details Commands are matched to their responses by the command number, so several different commands
+ *           can be outstanding at the same time. Collect the response with sf40WaitCommand or sf40PollCommand,
+ *           or set command->completion to be called once it has arrived.
+ *           When sending fails the completion is called right away with result -1.
+ */
+int sf40SubmitCommand(sf40_t* lidar, lidarCommand_t* command){
+	uint16_t data_len = command->write ? command->length : 0;
+	if(data_len > MAX_RESPONSE_SIZE - 6) return -1;
+
+	uint8_t packet[MAX_RESPONSE_SIZE];
+	const uint8_t* request = packet;
+	uint16_t size = 6;
+	if(command->write) size = buildPacket(packet, command->command, true, command->payload, data_len);
+	else request = readRequest(packet, command->command);
+
+	pthread_mutex_lock(&lidar->lock);
+	if(lidar->pending[command->command] != NULL){
+		pthread_mutex_unlock(&lidar->lock);
+		return -1;
+	}
+	command->result = 0;
+	command->deadline = sf40MonotonicTime() + COMMAND_TIMEOUT_US;
+	lidar->pending[command->command] = command;
+	pthread_mutex_unlock(&lidar->lock);
+
+	if(sendPackets(lidar, request, size) < 0){
+		dropPending(lidar, command);
+		return -1;
+	}
+	return 0;
+}/*sf40SubmitCommand*/
+
+
+/*! \brief Wait for the response on a submitted command
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param command command that has been submitted
+ *  
+ *  \retval Amount of bytes in the response packet.
+ *  \retval -1 : no response was received within COMMAND_TIMEOUT_US or reading from the lidar has failed
+ * 
+ *  \details Responses for other outstanding commands that arrive in the meantime are handed to them,
+ *           so waiting for them afterwards returns right away, and stream packets are put in the stream queue.
+ *           Between packets the thread sleeps until the lidar has sent new data. When the stream reader is running
+ *           it receives the response and this function only waits for it.
+ */
+int16_t sf40WaitCommand(sf40_t* lidar, lidarCommand_t* command){
+	uint64_t deadline = command->deadline;
+
+	// the reader thread takes the packets, wait for it to hand out the response
+	if(atomic_load_explicit(&lidar->reader.running, memory_order_acquire)){
+		struct timespec until = { .tv_sec = deadline / 1000000, .tv_nsec = (deadline % 1000000) * 1000 };
+
+		pthread_mutex_lock(&lidar->lock);
+		while(command->result == 0){
+			if(pthread_cond_timedwait(&lidar->responded, &lidar->lock, &until) == ETIMEDOUT) break;
+		}
+		bool timedOut = (command->result == 0);
+		pthread_mutex_unlock(&lidar->lock);
+
+		if(timedOut){
 			fprintf(stderr, "didnt receive response from lidar\n\r");
-			return -1;
+			dropPending(lidar, command);
 		}
+		return command->result;
+	}
 
-        uint8_t receivedPayload[220] = {0};
-		uint16_t receivedLenght = 0;
-        if(canReadByte(&lidarCOM)) receivedLenght = getPacket(receivedPayload); 
-		if(receivedPayload[3] == packet[3]){
-			#ifdef DEBUG
-			printf("Receiving: ");
-			#endif
-			for(int i = 0; i < receivedLenght+5; i++){
-				payload[i] = receivedPayload[i];
-				#ifdef DEBUG
-				printf("%02x ", receivedPayload[i]);
-				#endif
-			}
-			#ifdef DEBUG
-			printf("\n");
-			#endif
-			return receivedLenght;
+	while(command->result == 0){
+		if(pumpPackets(lidar) < 0) break;
+		if(command->result != 0) break;
+
+		int ready = rxWait(lidar, deadline);
+		if(ready < 0) break;
+		if(ready == 0){
+			fprintf(stderr, "didnt receive response from lidar\n\r");
+			break;
 		}
-    }
-    return -1;
-} /*readCommand*/
+	}
 
+	if(command->result == 0) dropPending(lidar, command);
+	return command->result;
+}/*sf40WaitCommand*/
 
-/*! \brief Read data to specific lidar command
+
+/*! \brief Check if the response on a submitted command has arrived, without waiting
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param command command that has been submitted
  *  
+ *  \retval Amount of bytes in the response packet.
+ *  \retval  0 : the response hasn't arrived yet
+ *  \retval -1 : no response was received within COMMAND_TIMEOUT_US or sending has failed
+ * 
+ *  \details When the stream reader isn't running this also receives the packets that have arrived,
+ *           so completions are called from the thread that polls. Can be called from a real-time loop.
+ */
+int16_t sf40PollCommand(sf40_t* lidar, lidarCommand_t* command){
+	if(!atomic_load_explicit(&lidar->reader.running, memory_order_acquire)) pumpPackets(lidar);
+	expireCommands(lidar);
+
+	pthread_mutex_lock(&lidar->lock);
+	int16_t result = command->result;
+	pthread_mutex_unlock(&lidar->lock);
+	return result;
+}/*sf40PollCommand*/
+
+
+/*! \brief Start reading a command without waiting for the response
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param request storage for the request, it has to stay valid until the completion has been called
+ * 
+ *  \param command command that needs to be read from
+ * 
+ *  \param response location where the response packet needs to be saved, must hold MAX_RESPONSE_SIZE bytes
+ * 
+ *  \param completion function called once the response has arrived or the command has failed, can be NULL
+ * 
+ *  \param user passed to completion
+ *  
+ *  \retval  0 : the request has been send
+ *  \retval -1 : sending has failed or a response for the same command is still pending
+ * 
+ *  \details The sf40DecodeX functions turn the response into the same value the blocking getter returns.
+ *           The completion is called from the thread that receives the response: the stream reader when it is running,
+ *           otherwise the thread calling sf40PollCommand, sf40WaitCommand or sf40GetStream.
+ */
+int sf40ReadAsync(sf40_t* lidar, lidarCommand_t* request, uint8_t command, uint8_t* response, sf40Completion_t completion, void* user){
+	*request = (lidarCommand_t){ .command = command, .write = false, .response = response, .completion = completion, .user = user };
+	return sf40SubmitCommand(lidar, request);
+}/*sf40ReadAsync*/
+
+
+/*! \brief Start writing to a command without waiting for the response
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param request storage for the request, it has to stay valid until the completion has been called
+ * 
  *  \param command command that needs to be written to
- *   
- *  \param payload payload that needs to be send
+ * 
+ *  \param payload payload that needs to be send, it is copied before this function returns
  * 
  *  \param data_len number of bytes in payload
+ * 
+ *  \param completion function called once the lidar has answered or the command has failed, can be NULL
+ * 
+ *  \param user passed to completion
  *  
- *  \retval  0 : data has been correctly send and proper response has been received
- *  \retval -1 : if sending from the lidar has failed
+ *  \retval  0 : the request has been send
+ *  \retval -1 : sending has failed or a response for the same command is still pending
+ */
+int sf40WriteAsync(sf40_t* lidar, lidarCommand_t* request, uint8_t command, const void* payload, uint16_t data_len, sf40Completion_t completion, void* user){
+	*request = (lidarCommand_t){ .command = command, .write = true, .payload = payload, .length = data_len, .completion = completion, .user = user };
+	return sf40SubmitCommand(lidar, request);
+}/*sf40WriteAsync*/
+
+
+/*! \brief Read data from specific lidar command
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param command command that needs to be read from
+ *  
+ *  \param payload location where data needs to be saved
+ *  
+ *  \retval Amount of bytes in data packet.
+ *  \retval -1 : if reading from the lidar has failed
  * 
  */
-int writeCommand(uint8_t command, void* payload, uint16_t data_len){
-	flag_t header;
-	header.pay_len = 1 + data_len;
-	header.rw = 1;
-	
-	uint8_t packet[6 + data_len];
-	packet[0] = STARTBIT;
-	packet[1] = header.sr;
-	packet[2] = header.sr >> 8;
-	packet[3] = command;
-	for(int i = 0; i < data_len; i++){
-		packet[4 + i] = ((uint8_t *)payload)[i];
-	}
-	packet[4 + data_len] = createCRC(packet, 4 + data_len);
-	packet[5 + data_len] = createCRC(packet, 4 + data_len) >> 8;
-	
+int16_t sf40ReadCommand(sf40_t* lidar, uint8_t command, uint8_t* payload){
+	uint8_t receivedPayload[MAX_RESPONSE_SIZE];
+	lidarCommand_t request = { .command = command, .write = false, .response = receivedPayload };
+	if(sf40SubmitCommand(lidar, &request) < 0) return -1;
+
+	int16_t receivedLenght = sf40WaitCommand(lidar, &request);
+	if(receivedLenght < 0) return -1;
+
 	#ifdef DEBUG
-	printf("Sending: ");
+	printf("Receiving: ");
 	#endif
-	for(int i = 0; i < 6 + data_len; i++){
-		sendByte(&lidarCOM, packet[i]);
+	for(int i = 0; i < receivedLenght+5; i++){
+		payload[i] = receivedPayload[i];
 		#ifdef DEBUG
-		printf("%02x ", packet[i]);
+		printf("%02x ", receivedPayload[i]);
 		#endif
 	}
 	#ifdef DEBUG
 	printf("\n");
 	#endif
+	return receivedLenght;
+} /*sf40ReadCommand*/
 
-    uint16_t cycles_Waited = 0;
-    while(true){
-        usleep(10);
-        cycles_Waited++;
-        
-        //if the wait time is longer then 100ms report it as a not succesfull
-        if(cycles_Waited > 10000){
-			fprintf(stderr, "didnt receive response from lidar\n\r");
-			return -1;
+
+/*! \brief Read data to specific lidar command
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param command command that needs to be written to
+ *   
+ *  \param payload payload that needs to be send
+ * 
+ *  \param data_len number of bytes in payload
+ *  
+ *  \retval  0 : data has been correctly send and proper response has been received
+ *  \retval -1 : if sending from the lidar has failed
+ * 
+ */
+int sf40WriteCommand(sf40_t* lidar, uint8_t command, void* payload, uint16_t data_len){
+	lidarCommand_t request = { .command = command, .write = true, .payload = payload, .length = data_len };
+	if(sf40SubmitCommand(lidar, &request) < 0) return -1;
+
+	if(sf40WaitCommand(lidar, &request) < 0) return -1;
+	return 0;
+}/*sf40WriteCommand*/
+
+
+/*! \brief Send several commands to the lidar at once
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param commands commands that need to be send, the result of each one is saved in it
+ * 
+ *  \param count number of commands
+ *  
+ *  \retval Amount of commands that received a response.
+ *  \retval -1 : if sending to the lidar has failed
+ * 
+ *  \details The packets of all commands are send with a single write, as long as they fit in BATCH_SIZE bytes.
+ *           The responses are matched to the commands as they arrive, so a burst of commands costs
+ *           about one round trip in total. A command that is in the list twice is send again once
+ *           the response on the first one has been received. A command whose number is still waiting
+ *           for the response of another caller isn't send, its result is -1.
+ */
+int sf40SendCommands(sf40_t* lidar, lidarCommand_t* commands, int count){
+	uint8_t batch[BATCH_SIZE];
+	uint16_t size = 0;
+	int handled = 0;
+	while(handled < count){
+		lidarCommand_t* command = &commands[handled];
+		uint16_t data_len = command->write ? command->length : 0;
+		if(data_len > BATCH_SIZE - 6) break;
+
+		// send what has been collected when this packet doesn't fit anymore
+		if(size + 6 + data_len > BATCH_SIZE){
+			if(sendPackets(lidar, batch, size) < 0) break;
+			size = 0;
 		}
 
-        uint8_t receivedPayload[220] = {0};
-        if(canReadByte(&lidarCOM)) getPacket(receivedPayload);
-        if(receivedPayload[3] == command) return 0;
-    }
-    return -1;
-}/*writeCommand*/
+		// claim the command number in the same lock section that checks it, so no other caller can take it in between
+		pthread_mutex_lock(&lidar->lock);
+		lidarCommand_t* pending = lidar->pending[command->command];
+		if(pending == NULL){
+			command->result = 0;
+			command->deadline = sf40MonotonicTime() + COMMAND_TIMEOUT_US;
+			lidar->pending[command->command] = command;
+		}
+		pthread_mutex_unlock(&lidar->lock);
+
+		if(pending != NULL){
+			bool ours = false;
+			for(int i = 0; i < handled; i++) ours |= (pending == &commands[i]);
+
+			// an earlier command of this list: send the batch, wait for its response and try again
+			if(ours){
+				if(size > 0 && sendPackets(lidar, batch, size) < 0) break;
+				size = 0;
+				sf40WaitCommand(lidar, pending);
+				continue;
+			}
+
+			// someone else is waiting for this command number, their response can't be told apart from ours
+			command->result = -1;
+			if(command->completion != NULL) command->completion(command, command->user);
+			handled++;
+			continue;
+		}
+
+		if(command->write) size += buildPacket(&batch[size], command->command, true, command->payload, data_len);
+		else{
+			const uint8_t* request = readRequest(&batch[size], command->command);
+			if(request != &batch[size]) memcpy(&batch[size], request, 6);
+			size += 6;
+		}
+		handled++;
+	}
+
+	// don't leave commands behind that are waiting for a response, dropPending only touches the ones this call registered
+	if(handled < count || (size > 0 && sendPackets(lidar, batch, size) < 0)){
+		for(int i = 0; i < handled; i++) dropPending(lidar, &commands[i]);
+		return -1;
+	}
+
+	int received = 0;
+	for(int i = 0; i < count; i++){
+		if(commands[i].result < 0) continue;
+		if(sf40WaitCommand(lidar, &commands[i]) > 0) received++;
+	}
+	return received;
+}/*sf40SendCommands*/
 
 /*! \brief A 16 byte string indicating the product model name.
  *  
+ *  \param lidar handle of the lidar
+ * 
  *  \param name location where the name should be saved
  *   
  * 	\details This will always be SF40 followed by a null terminator.
  *		 	 You can use this to verify the SF40/C is connected and operational over the selected interface.
  */
-void getName(char* name){
+void sf40GetName(sf40_t* lidar, char* name){
 	uint8_t payload[22];
-	readCommand(LIDAR_PRODUCT_NAME, payload);
+	sf40ReadCommand(lidar, LIDAR_PRODUCT_NAME, payload);
 
 	int i;
 	for(i = 0; i < 16; i++){
@@ -235,18 +911,20 @@ void getName(char* name){
 		if(payload[i+4] == '\0') break;
 	}
 	name[i+4] = '\0';
-}/*getName*/
+}/*sf40GetName*/
 
 
 /*! \brief A 16 byte string (null terminated) of the serial identifier assigned during production
  *  
+ *  \param lidar handle of the lidar
+ * 
  *  \param serialNumber location where the serial number should be saved
  *   
  */
-void getSerialNumber(char* serialNumber){
+void sf40GetSerialNumber(sf40_t* lidar, char* serialNumber){
 	uint8_t payload[22];
 
-	uint8_t dataLenght = readCommand(LIDAR_SERIAL_NUMBER, payload);
+	uint8_t dataLenght = sf40ReadCommand(lidar, LIDAR_SERIAL_NUMBER, payload);
 
 	int i;
 	for(i = 0; i < dataLenght; i++){
@@ -254,333 +932,760 @@ void getSerialNumber(char* serialNumber){
 		if(payload[i+4] == '\0') break;
 	}
 	payload[i+4] = '\0';
-}/*getSerialNumber*/
+}/*sf40GetSerialNumber*/
 
 
 /*! \brief Userdata allows 16 bytes to be stored for any purpose.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param data data to be stored on the lidar;
  *   
  */
-void sendUserData(uint8_t* data){
-	writeCommand(LIDAR_USER_DATA, data, 16);
-}/*sendUserData*/
+void sf40SendUserData(sf40_t* lidar, uint8_t* data){
+	sf40WriteCommand(lidar, LIDAR_USER_DATA, data, 16);
+}/*sf40SendUserData*/
 
 
 /*! \brief Userdata allows 16 bytes to be read for any purpose.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param data data to be read from the lidar;
  *   
  */
-void getUserData(uint8_t* data){
+void sf40GetUserData(sf40_t* lidar, uint8_t* data){
 	uint8_t payload[22];
-	uint8_t dataLenght = readCommand(LIDAR_SERIAL_NUMBER, payload);
+	int16_t dataLenght = sf40ReadCommand(lidar, LIDAR_USER_DATA, payload);
 	
-	for(int i = 0; i < dataLenght; i++){
-		data[i] = (char)payload[i+4];
+	// the payload length includes the command byte
+	for(int i = 0; i < dataLenght - 1 && i < 16; i++){
+		data[i] = payload[i+4];
 	}
-}/*getUserData*/
+}/*sf40GetUserData*/
 
 
 /*! \brief The baud rate as used by the serial interface.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param baudrate baudrate to be set
  *   
  * 	\details  This parameter only takes effect when the serial interface is first
  *			  enabled after power-up or restart.
  */
-void setBaudrate(lidarBaudrate_t baudrate){
-	writeCommand(LIDAR_BAUD_RATE, &baudrate, 1);
-}/*setBaudrate*/
+void sf40SetBaudrate(sf40_t* lidar, lidarBaudrate_t baudrate){
+	sf40WriteCommand(lidar, LIDAR_BAUD_RATE, &baudrate, 1);
+}/*sf40SetBaudrate*/
+
+
+/*! \brief Security token in a LIDAR_TOKEN response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \return 16 bit security token
+ */
+uint16_t sf40DecodeToken(const uint8_t* response){
+	return response[4] + ((uint16_t)response[5] << 8);
+}/*sf40DecodeToken*/
 
 
 /*! \brief Current safety token required for performing certain operations. 
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \return 16 bit security token
  *   
  * 	\details Once a token has been used it will expire and a new token is created.
  */
-uint16_t getToken(void){
+uint16_t sf40GetToken(sf40_t* lidar){
 	uint8_t payload[8];
 	
-	readCommand(LIDAR_TOKEN, payload);
+	sf40ReadCommand(lidar, LIDAR_TOKEN, payload);
 
-	return payload[4] + ((uint16_t)payload[5] << 8);
-}/*getToken*/
+	return sf40DecodeToken(payload);
+}/*sf40GetToken*/
 
 
 /*! \brief Save current lidar settings.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param token security token.
  *   
  * 	\details  Several commands write to parameters that can persist across power cycles. 
  *            These parameters will only persist once the Save parameters command has been written with the appropriate token . 
  *            The safety token is used to prevent unintentional writes and once a successful save has completed the token will expire.
  */
-void saveParameters(uint16_t token){
-	writeCommand(LIDAR_SAVE_PARAMETERS, &token, 2);
-}/*saveParameters*/
+void sf40SaveParameters(sf40_t* lidar, uint16_t token){
+	sf40WriteCommand(lidar, LIDAR_SAVE_PARAMETERS, &token, 2);
+}/*sf40SaveParameters*/
 
 
 /*! \brief Writing the safety token to this function will restart the SF40/C.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param token security token.
  */
-void restartLidar(uint16_t token){
-	writeCommand(LIDAR_RESET, &token, 2);
-}/*restartLidar*/
+void sf40RestartLidar(sf40_t* lidar, uint16_t token){
+	sf40WriteCommand(lidar, LIDAR_RESET, &token, 2);
+}/*sf40RestartLidar*/
+
+
+/*! \brief Logic voltage in a LIDAR_INCOMING_VOLTAGE response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \return A float with the logic voltage in volts.
+ */
+float sf40DecodeVoltage(const uint8_t* response){
+	return LIDAR_VOLTAGE((uint32_t)response[7]<<24 | (uint32_t)response[6]<<16 | 
+						 (uint32_t)response[5]<<8 | (uint32_t)response[4]);
+}/*sf40DecodeVoltage*/
 
 
 /*! \brief The incoming voltage is directly measured from the incoming 5 V line.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \return A float with the logic voltage in volts.
  */
-float getVoltage(void){
+float sf40GetVoltage(sf40_t* lidar){
 	uint8_t payload[10];
 
-	readCommand(LIDAR_INCOMING_VOLTAGE, payload);
+	sf40ReadCommand(lidar, LIDAR_INCOMING_VOLTAGE, payload);
 
-	return LIDAR_VOLTAGE((uint32_t)payload[7]<<24 || (uint32_t)payload[6]<<16 || 
-						 (uint32_t)payload[5]<<8 || (uint32_t)payload[4]);
-}/*getVoltage*/
+	return sf40DecodeVoltage(payload);
+}/*sf40GetVoltage*/
     
 
+/*! \brief Motor voltage in a LIDAR_MOTOR_VOLTAGE response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \return A float with the motor voltage in volts.
+ */
+float sf40DecodeMotorVoltage(const uint8_t* response){
+	return (float)(response[5]<<8 | response[4])/1000.0f;
+}/*sf40DecodeMotorVoltage*/
+
+
 /*! \brief Reading this function will return the voltage drawn by the motor.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \return A float with the motor voltage in volts.
  */
-float getMotorVoltage(void){
+float sf40GetMotorVoltage(sf40_t* lidar){
 	uint8_t payload[8];
 	
-	readCommand(LIDAR_MOTOR_VOLTAGE, payload);
+	sf40ReadCommand(lidar, LIDAR_MOTOR_VOLTAGE, payload);
 
-	return (float)(payload[5]<<8 | payload[4])/1000.0f;
-}/*getMotorVoltage*/
+	return sf40DecodeMotorVoltage(payload);
+}/*sf40GetMotorVoltage*/
     
 
+/*! \brief Temperature in a LIDAR_TEMPRATURE response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \return A float with the temperature in degree's Celcius
+ */
+float sf40DecodeTemperature(const uint8_t* response){
+	// the temperature is signed, below 0 degrees it has the top bit set
+	return (int32_t)((uint32_t)response[7]<<24 | (uint32_t)response[6]<<16 |
+					 (uint32_t)response[5]<<8 | (uint32_t)response[4]) / 100.0f;
+}/*sf40DecodeTemperature*/
+
+
 /*! \brief Reading this function will return the temperature.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \return A float with the temperature in degree's Celcius
  */
-float getTemperature(void){
+float sf40GetTemperature(sf40_t* lidar){
 	uint8_t payload[10];
 	
-	readCommand(LIDAR_TEMPRATURE, payload);
+	sf40ReadCommand(lidar, LIDAR_TEMPRATURE, payload);
 
-	return ((uint32_t)payload[7]<<24 || (uint32_t)payload[6]<<16 || 
-			(uint32_t)payload[5]<<8 || (uint32_t)payload[4]) / 100.0f;
-}/*getTemperature*/
+	return sf40DecodeTemperature(payload);
+}/*sf40GetTemperature*/
     
 
+/*! \brief Number of revolutions in a LIDAR_REVOLUTIONS response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \return 32 bit number with the amount of revolutions
+ */
+uint32_t sf40DecodeRevolutions(const uint8_t* response){
+	return 	((uint32_t)response[7]<<24 | (uint32_t)response[6]<<16 | 
+			 (uint32_t)response[5]<<8 | (uint32_t)response[4]);
+}/*sf40DecodeRevolutions*/
+
+
 /*! \brief Reading this function will return the number of full revolutions since start-up
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \return 32 bit number with the amount of revolutions
  * 
  *  \details Note that this value will reset to zero after 4294967295 revolutions.
  */
-uint32_t getRevolutions(void){
+uint32_t sf40GetRevolutions(sf40_t* lidar){
 	uint8_t payload[10];
 	
-	readCommand(LIDAR_TEMPRATURE, payload);
+	sf40ReadCommand(lidar, LIDAR_REVOLUTIONS, payload);
 
-	return 	((uint32_t)payload[7]<<24 || (uint32_t)payload[6]<<16 || 
-			 (uint32_t)payload[5]<<8 || (uint32_t)payload[4]);
-}/*getRevolutions*/
+	return sf40DecodeRevolutions(payload);
+}/*sf40GetRevolutions*/
     
 
+/*! \brief Alarm states in a LIDAR_ALARM_STATE response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \return 1 bit states for all alarms
+ */
+alarms_t sf40DecodeAlarmState(const uint8_t* response){
+	alarms_t alarms;
+	alarms.byte = response[4];
+	return alarms;
+}/*sf40DecodeAlarmState*/
+
+
 /*! \brief Reading this function will return a byte with the current state of all alarms.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param alarms array if 1 bit states for all alarms
  * 
  *  \details Each bit represents 1 of the 7 alarms, if the bit is set then the alarm is currently triggered. 
  * 			 The most significant bit is set when any alarm is currently triggered.
  */
-void getAlarmState(alarms_t* alarms){
+void sf40GetAlarmState(sf40_t* lidar, alarms_t* alarms){
 	uint8_t payload[7];
 	
-	readCommand(LIDAR_ALARM_STATE, payload);
+	sf40ReadCommand(lidar, LIDAR_ALARM_STATE, payload);
+
+	*alarms = sf40DecodeAlarmState(payload);
+}/*sf40GetAlarmState*/
+    
+
+/*! \brief Motor state in a LIDAR_MOTOR_STATE response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \return motor state
+ */
+motorState_t sf40DecodeMotorState(const uint8_t* response){
+	return (motorState_t)response[4];
+}/*sf40DecodeMotorState*/
+
+
+/*! \brief Reading this function will return the current state of the motor. 
+ *
+ *  \param lidar handle of the lidar
+ * 
+ *  \return returns motor state
+ * 
+ *  \details This can be useful to debug or check start-up conditions.
+ */
+motorState_t sf40GetMotorState(sf40_t* lidar){
+	uint8_t payload[7];
+	
+	sf40ReadCommand(lidar, LIDAR_MOTOR_STATE, payload);
+
+	return sf40DecodeMotorState(payload);
+}/*sf40GetMotorState*/
+
+
+/*! \brief Turn on or off continuosly outputting data without requests.
+ *
+ *  \param lidar handle of the lidar
+ * 
+ *  \param enabled turn on or off the stream function
+ */
+void sf40EnableStream(sf40_t* lidar, bool enabled){
+	uint8_t payload[4] = {0};
+    payload[0] = enabled ? 3 : 0;
+
+    sf40WriteCommand(lidar, LIDAR_STREAM, payload, 4);
+}
+
+uint8_t sf40GetStreamState(sf40_t* lidar){
+	uint8_t payload[7];
+	
+	sf40ReadCommand(lidar, LIDAR_STREAM, payload);
+
+	return payload[4];
+}
+
+/*! \brief Decode a distance output packet
+ *  
+ *  \param payload received LIDAR_DISTANCE_OUTPUT packet
+ * 
+ *  \param outputData Location where streamdata packet needs to be saved
+ *  
+ *  \retval  0 : outputData has been filled
+ *  \retval -2 : the packet holds more points than outputData can hold
+ */
+static int decodeStream(const uint8_t* payload, streamOutput_t* outputData){
+	uint16_t pointCount = (uint16_t)(payload[15]<<8 | payload[14]);
+	if(pointCount > sizeof(outputData->pointDistances) / sizeof(outputData->pointDistances[0])) return -2;
+
+	outputData->alarmState.byte = payload[4];
+	outputData->pps 			= (uint16_t)(payload[6]<<8 | payload[5]);
+	outputData->forwardOffset 	= (int16_t)(payload[8]<<8 | payload[7]);
+	outputData->motorVoltage	= (int16_t)(payload[10]<<8 | payload[9]);
+	outputData->revolutionIndex = payload[11];
+	outputData->pointTotal		= (uint16_t)(payload[13]<<8 | payload[12]);
+	outputData->pointCount		= pointCount;
+	outputData->pointStartIndex = (uint16_t)(payload[17]<<8 | payload[16]);
+
+	// the distances are little endian in the packet, so they can be copied as they are on little endian hosts
+	#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(outputData->pointDistances, &payload[18], pointCount * sizeof(int16_t));
+	#else
+	for(uint16_t i = 0; i < outputData->pointCount; i++){
+		outputData->pointDistances[i] = (int16_t)(payload[(i*2)+19]<<8 | payload[(i*2)+18]);
+	}
+	#endif
+
+	return 0;
+}/*decodeStream*/
+
+
+/*! \brief Count the stream points that were skipped before a received packet
+ *  
+ *  \details The packet should start where the previous one ended. Points up to the start of the packet are lost,
+ *           including the rest of the previous revolution and every revolution in between when the revolution index jumped.
+ *           A packet that starts before the expected point in the same revolution is taken as the new position.
+ */
+static void trackStream(sf40_t* lidar, uint8_t revolutionIndex, uint16_t pointTotal, uint16_t pointStartIndex, uint16_t pointCount){
+	streamLoss_t* loss = &lidar->reader.loss;
+
+	if(loss->tracking){
+		uint32_t lost = 0;
+		uint8_t jump = (uint8_t)(revolutionIndex - loss->revolutionIndex);
+		if(jump == 0){
+			if(pointStartIndex > loss->nextIndex) lost = pointStartIndex - loss->nextIndex;
+		}
+		else{
+			if(loss->pointTotal > loss->nextIndex) lost = loss->pointTotal - loss->nextIndex;
+			lost += (uint32_t)(jump - 1) * pointTotal + pointStartIndex;
+			if(jump > 1) atomic_fetch_add_explicit(&loss->lostRevolutions, jump - 1, memory_order_relaxed);
+		}
+		if(lost) atomic_fetch_add_explicit(&loss->lostPoints, lost, memory_order_relaxed);
+	}
+
+	loss->tracking = true;
+	loss->revolutionIndex = revolutionIndex;
+	loss->pointTotal = pointTotal;
+	loss->nextIndex = pointStartIndex + pointCount;
+}/*trackStream*/
+
+
+/*! \brief Copy a stream packet into the next free place of the queue
+ *  
+ *  \param packet received LIDAR_DISTANCE_OUTPUT packet
+ * 
+ *  \param length payload length of the packet
+ * 
+ *  \details Only called by whoever receives the packets, the reader thread when it is running.
+ *           When the queue is full the new packet is dropped, as are packets too short for their point count.
+ *           Points missing in between queued packets are counted once the packet is sure to be queued,
+ *           so the points of a dropped packet end up in lostPoints like points that never arrived.
+ *           This is the second copy of a packet: rxTake already copied it from the receive buffer into the parser frame.
+ */
+static void pushStream(sf40_t* lidar, const uint8_t* packet, int16_t length){
+	streamQueue_t* queue = &lidar->reader.queue;
+	if(length < 15) return;
+
+	uint16_t pointCount = (uint16_t)(packet[15]<<8 | packet[14]);
+	if(18 + pointCount * 2 > 3 + length){
+		atomic_fetch_add_explicit(&lidar->reader.loss.lengthErrors, 1, memory_order_relaxed);
+		return;
+	}
+
+	unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+	if(head - tail >= STREAM_QUEUE_SIZE){
+		atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+		return;
+	}
+	trackStream(lidar, packet[11], (uint16_t)(packet[13]<<8 | packet[12]), (uint16_t)(packet[17]<<8 | packet[16]), pointCount);
+	memcpy(queue->packets[head & (STREAM_QUEUE_SIZE - 1)], packet, length + 5);
 
-	alarms->byte = payload[4];
-}/*getAlarmState*/
-    
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
 
-/*! \brief Reading this function will return the current state of the motor. 
- *
- *  \return returns motor state
+	unsigned int depth = head + 1 - tail;
+	if(depth > atomic_load_explicit(&queue->highWater, memory_order_relaxed)){
+		atomic_store_explicit(&queue->highWater, depth, memory_order_relaxed);
+	}
+}/*pushStream*/
+
+
+/*! \brief Look at the oldest stream packet where it lies in the queue
+ *  
+ *  \param lidar handle of the lidar
  * 
- *  \details This can be useful to debug or check start-up conditions.
+ *  \param view filled with the header of the packet and a pointer to its distances
+ *  
+ *  \retval  0 : view points at the oldest packet
+ *  \retval -1 : failed getting packet
+ *  \retval -3 : no complete packet has arrived yet, view is not changed.
+ * 
+ *  \details The packet stays in the queue until it is given back with sf40ReleaseStream,
+ *           so view->distances stays valid until then. Until it is released every call returns the same packet.
+ *           The view isn't copied out of the queue, but the packet was copied twice to get there, see pushStream.
+ *           Like sf40GetStream this doesn't wait for data.
  */
-motorState_t getMotorState(void){
-	uint8_t payload[7];
-	
-	readCommand(LIDAR_MOTOR_STATE, payload);
+int sf40AcquireStream(sf40_t* lidar, streamView_t* view){
+	if(!atomic_load_explicit(&lidar->reader.running, memory_order_acquire)){
+		if(pumpPackets(lidar) < 0) return -1;
+	}
 
-	return (motorState_t)payload[4];
-}/*getMotorState*/
+	streamQueue_t* queue = &lidar->reader.queue;
+	unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	unsigned int head = atomic_load_explicit(&queue->head, memory_order_acquire);
+	if(head == tail) return -3;
+
+	const uint8_t* packet = queue->packets[tail & (STREAM_QUEUE_SIZE - 1)];
+	view->packet			= packet;
+	view->alarmState.byte	= packet[4];
+	view->pps				= (uint16_t)(packet[6]<<8 | packet[5]);
+	view->forwardOffset		= (int16_t)(packet[8]<<8 | packet[7]);
+	view->motorVoltage		= (int16_t)(packet[10]<<8 | packet[9]);
+	view->revolutionIndex	= packet[11];
+	view->pointTotal		= (uint16_t)(packet[13]<<8 | packet[12]);
+	view->pointCount		= (uint16_t)(packet[15]<<8 | packet[14]);
+	view->pointStartIndex	= (uint16_t)(packet[17]<<8 | packet[16]);
+	view->distances			= &packet[18];
+	return 0;
+}/*sf40AcquireStream*/
 
 
-/*! \brief Turn on or off continuosly outputting data without requests.
- *
- *  \param enabled turn on or off the stream function
+/*! \brief Give a packet from sf40AcquireStream back to the queue
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param view view filled by sf40AcquireStream, it can't be used anymore afterwards
  */
-void enableStream(bool enabled){
-	uint8_t payload[4] = {0};
-    payload[0] = enabled ? 3 : 0;
-
-    writeCommand(LIDAR_STREAM, payload, 4);
-}
+void sf40ReleaseStream(sf40_t* lidar, streamView_t* view){
+	streamQueue_t* queue = &lidar->reader.queue;
+	unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	if(view->packet != queue->packets[tail & (STREAM_QUEUE_SIZE - 1)]) return;
 
-uint8_t getStreamState(void){
-	uint8_t payload[7];
-	
-	readCommand(LIDAR_STREAM, payload);
+	view->packet = NULL;
+	view->distances = NULL;
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+}/*sf40ReleaseStream*/
 
-	return payload[4];
-}
 
 /*! \brief Retrieve complete stream packed from incomming buffer
  *  
+ *  \param lidar handle of the lidar
+ * 
  *  \param outputData Location where streamdata packet needs to be saved
  *  
  *  \retval  0 : the outputeData has correctly be update with a new list of data points.
  *  \retval -1 : failed getting packet
- *  \retval -2 : received data is not streamed data. 
+ *  \retval -2 : the packet holds more points than outputData can hold, it is dropped.
+ *  \retval -3 : no complete packet has arrived yet, outputData is not changed.
  * 
+ *  \details This function doesn't wait for data, a partially received packet is kept until the next call.
+ *           Stream packets that arrive while waiting on a command are queued, so they are returned here later.
+ *           When the stream reader is running the packet is taken from its queue.
  */
-int getStream(streamOutput_t* outputData){
-	uint8_t payload[420];
-	if(getPacket(payload) <= 0) return -1;
-	if(payload[3] != LIDAR_DISTANCE_OUTPUT) return -2;
+int sf40GetStream(sf40_t* lidar, streamOutput_t* outputData){
+	streamView_t view;
+	int result = sf40AcquireStream(lidar, &view);
+	if(result < 0) return result;
 
-	outputData->alarmState.byte = payload[4];
-	outputData->pps 			= (uint16_t)(payload[6]<<8 | payload[5]);
-	outputData->forwardOffset 	= (int16_t)(payload[8]<<8 | payload[7]);
-	outputData->motorVoltage	= (int16_t)(payload[10]<<8 | payload[9]);
-	outputData->revolutionIndex = payload[11];
-	outputData->pointTotal		= (uint16_t)(payload[13]<<8 | payload[12]);
-	outputData->pointCount		= (uint16_t)(payload[15]<<8 | payload[14]);
-	outputData->pointStartIndex = (uint16_t)(payload[17]<<8 | payload[16]);
+	result = decodeStream(view.packet, outputData);
+	sf40ReleaseStream(lidar, &view);
+	return result;
+}/*sf40GetStream*/
 
-	for(uint16_t i = 0; i < outputData->pointCount; i++){
-		outputData->pointDistances[i] = (int16_t)(payload[(i*2)+19]<<8 | payload[(i*2)+18]);
+
+/*! \brief Reader thread, receives every packet and hands it out until it is stopped
+ */
+static void* streamReaderThread(void* argument){
+	sf40_t* lidar = argument;
+
+	while(atomic_load_explicit(&lidar->reader.running, memory_order_relaxed)){
+		if(pumpPackets(lidar) < 0) break;
+		expireCommands(lidar);
+
+		// wake up regularly to see if the reader has been stopped
+		if(rxWait(lidar, sf40MonotonicTime() + READER_WAKEUP_US) < 0) break;
 	}
+	return NULL;
+}/*streamReaderThread*/
+
 
+/*! \brief Start a thread that receives and decodes the stream in the background
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \retval  0 : the reader is running
+ *  \retval -1 : the thread couldn't be started or the lidar isn't connected
+ * 
+ *  \details getStream will take its packets from the queue filled by this thread.
+ *           Commands can still be used, the thread hands their responses to the waiting caller.
+ */
+int sf40StartStreamReader(sf40_t* lidar){
+	if(atomic_load(&lidar->reader.running)) return 0;
+	if(lidar->transport == NULL) return -1;
+
+	atomic_store(&lidar->reader.queue.highWater, 0);
+	atomic_store(&lidar->reader.queue.dropped, 0);
+	atomic_store(&lidar->reader.loss.crcErrors, 0);
+	atomic_store(&lidar->reader.loss.lengthErrors, 0);
+	atomic_store(&lidar->reader.loss.lostPoints, 0);
+	atomic_store(&lidar->reader.loss.lostRevolutions, 0);
+	lidar->reader.loss.tracking = false;
+
+	atomic_store(&lidar->reader.running, true);
+	if(pthread_create(&lidar->reader.thread, NULL, streamReaderThread, lidar) != 0){
+		atomic_store(&lidar->reader.running, false);
+		return -1;
+	}
 	return 0;
-}/*getStream*/
+}/*sf40StartStreamReader*/
+
+
+/*! \brief Stop the stream reader thread
+ * 
+ *  \param lidar handle of the lidar
+ * 
+ *  \details Packets still waiting in the queue can still be taken with getStream.
+ */
+void sf40StopStreamReader(sf40_t* lidar){
+	if(!atomic_load(&lidar->reader.running)) return;
+
+	atomic_store(&lidar->reader.running, false);
+	pthread_join(lidar->reader.thread, NULL);
+}/*sf40StopStreamReader*/
+
+
+/*! \brief Read the queue and loss counters of the stream
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param stats location where the counters need to be saved
+ */
+void sf40GetStreamStats(sf40_t* lidar, streamStats_t* stats){
+	stats->depthHighWater  = atomic_load_explicit(&lidar->reader.queue.highWater, memory_order_relaxed);
+	stats->dropped         = atomic_load_explicit(&lidar->reader.queue.dropped, memory_order_relaxed);
+	stats->crcErrors       = atomic_load_explicit(&lidar->reader.loss.crcErrors, memory_order_relaxed);
+	stats->lengthErrors    = atomic_load_explicit(&lidar->reader.loss.lengthErrors, memory_order_relaxed);
+	stats->lostPoints      = atomic_load_explicit(&lidar->reader.loss.lostPoints, memory_order_relaxed);
+	stats->lostRevolutions = atomic_load_explicit(&lidar->reader.loss.lostRevolutions, memory_order_relaxed);
+}/*sf40GetStreamStats*/
+
+
+/*! \brief Set the handler that is called when the alarm state in the stream changes
+ *  
+ *  \param lidar handle of the lidar
+ * 
+ *  \param handler called with the alarms that went on and off, NULL to stop listening
+ * 
+ *  \param user passed to handler
+ * 
+ *  \details Every distance output packet carries the state of the alarms. It is compared with the previous packet
+ *           as the packet is received, so a change is known within one packet instead of by polling getAlarmState.
+ *           The first packet after setting a handler reports every alarm that is on as rising.
+ *           The handler is called by whoever receives the packets, the stream reader thread when it is running,
+ *           and must not wait on commands of the same lidar.
+ */
+void sf40SetAlarmHandler(sf40_t* lidar, sf40AlarmHandler_t handler, void* user){
+	pthread_mutex_lock(&lidar->lock);
+	lidar->alarms.handler = handler;
+	lidar->alarms.user = user;
+	lidar->alarms.last = 0;
+	pthread_mutex_unlock(&lidar->lock);
+}/*sf40SetAlarmHandler*/
 
 
 /*! \brief Writing to this function will enable or disable the firing of the laser.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param enabled turn on or off the laser
  */
-void enableLaser(bool enabled){
-	writeCommand(LIDAR_LASER_FIRING, &enabled, 1);
-}/*enableLaser*/
+void sf40EnableLaser(sf40_t* lidar, bool enabled){
+	sf40WriteCommand(lidar, LIDAR_LASER_FIRING, &enabled, 1);
+}/*sf40EnableLaser*/
+
+
+/*! \brief Laser firing state in a LIDAR_LASER_FIRING response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \return boolean if laser is firing or not
+ */
+bool sf40DecodeLaser(const uint8_t* response){
+	return (bool)response[4];
+}/*sf40DecodeLaser*/
 
 
 /*! \brief Reading this function will indicate the current laser firing state.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \return boolean if laser is firing or not
  */
-bool checkLaser(void){
+bool sf40CheckLaser(sf40_t* lidar){
 	uint8_t payload[7];
 
-	readCommand(LIDAR_LASER_FIRING, payload);
+	sf40ReadCommand(lidar, LIDAR_LASER_FIRING, payload);
 
-	return (bool)payload[4];
-}/*checkLaser*/
+	return sf40DecodeLaser(payload);
+}/*sf40CheckLaser*/
 
 
 /*! \brief The output rate controls the amount of data sent to the host when distance output streaming is enabled.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param outputRate Amount of points per second
  */
-void setOutputRate(lidarOutputRate_t outputRate){
-	writeCommand(LIDAR_OUTPUT_RATE, &outputRate, 1);
-}/*setOutputRate*/
+void sf40SetOutputRate(sf40_t* lidar, lidarOutputRate_t outputRate){
+	sf40WriteCommand(lidar, LIDAR_OUTPUT_RATE, &outputRate, 1);
+}/*sf40SetOutputRate*/
+
+
+/*! \brief Output rate in a LIDAR_OUTPUT_RATE response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \return Amount of points per second
+ */
+lidarOutputRate_t sf40DecodeOutputRate(const uint8_t* response){
+	return (lidarOutputRate_t)response[4];
+}/*sf40DecodeOutputRate*/
 
 
 /*! \brief The output rate controls the amount of data sent to the host when distance output streaming is enabled.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \return Amount of points per second
  */
-lidarOutputRate_t getOutputRate(void){
+lidarOutputRate_t sf40GetOutputRate(sf40_t* lidar){
 	uint8_t payload[7];
 
-	readCommand(LIDAR_OUTPUT_RATE, payload);
+	sf40ReadCommand(lidar, LIDAR_OUTPUT_RATE, payload);
 
-	return (lidarOutputRate_t)payload[4];
-}/*getOutputRate*/
+	return sf40DecodeOutputRate(payload);
+}/*sf40GetOutputRate*/
+
+
+/*! \brief Distances in a LIDAR_DISTANCE response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \param receivedDistances struct where the received distances should be saved.
+ */
+void sf40DecodeDistance(const uint8_t* response, readDistance_t* receivedDistances){
+	receivedDistances->averageDistance 	= (response[5]<<8 | response[4]);
+	receivedDistances->closestDistance 	= (response[7]<<8 | response[6]);
+	receivedDistances->furthestDistance = (response[9]<<8 | response[8]);
+	receivedDistances->angle 			= (response[11]<<8 | response[10]);
+	receivedDistances->calculationTime	= ((uint32_t)response[15]<<24 | (uint32_t)response[14]<<16 | 
+			 							   (uint32_t)response[13]<<8 | (uint32_t)response[12]);
+}/*sf40DecodeDistance*/
 
 
 /*! \brief Reading this command will return the average , closest and furthest distance within an angular view
  *		   pointing in a specified direction.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param distanceSettings struct with different lidar distance settings
  * 
  *  \param receivedDistances struct where the received distances should be saved.
  */
-void getDistance(writeDistance_t distanceSettings, readDistance_t* receivedDistances){
-	writeCommand(LIDAR_DISTANCE, &distanceSettings, 6);
+void sf40GetDistance(sf40_t* lidar, writeDistance_t distanceSettings, readDistance_t* receivedDistances){
+	sf40WriteCommand(lidar, LIDAR_DISTANCE, &distanceSettings, 6);
 
 	uint8_t payload[18];
 
-	readCommand(LIDAR_DISTANCE, payload);
+	sf40ReadCommand(lidar, LIDAR_DISTANCE, payload);
 
-	receivedDistances->averageDistance 	= (payload[5]<<8 | payload[4]);
-	receivedDistances->closestDistance 	= (payload[7]<<8 | payload[6]);
-	receivedDistances->furthestDistance = (payload[9]<<8 | payload[8]);
-	receivedDistances->angle 			= (payload[11]<<8 | payload[10]);
-	receivedDistances->calculationTime	= ((uint32_t)payload[15]<<24 | (uint32_t)payload[14]<<16 || 
-			 							   (uint32_t)payload[13]<<8 | (uint32_t)payload[12]);
-}/*getDistance*/
+	sf40DecodeDistance(payload, receivedDistances);
+}/*sf40GetDistance*/
 
 
 /*! \brief The forward offset affects the position of the 0 degree direction.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param offset offset to be applied
  * 
  *  \details The orientation label on the front of the SF40/C marks the default 0 degree direction.
  */
-void setOffset(int16_t offset){
-	writeCommand(LIDAR_FORWARD_OFFSET, &offset, 2);
-}/*setOffset*/
+void sf40SetOffset(sf40_t* lidar, int16_t offset){
+	sf40WriteCommand(lidar, LIDAR_FORWARD_OFFSET, &offset, 2);
+}/*sf40SetOffset*/
+
+
+/*! \brief Forward offset in a LIDAR_FORWARD_OFFSET response
+ *
+ *  \param response response packet received for the command
+ * 
+ *  \return offset that is applied
+ */
+int16_t sf40DecodeOffset(const uint8_t* response){
+	return (int16_t)((response[5] << 8) | response[4]);
+}/*sf40DecodeOffset*/
 
 
 /*! \brief The forward offset affects the position of the 0 degree direction.
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \return offset that is applied
  * 
  *  \details The orientation label on the front of the SF40/C marks the default 0 degree direction.
  */
-int16_t getOffset(void){
+int16_t sf40GetOffset(sf40_t* lidar){
 	uint8_t payload[8];
-	readCommand(LIDAR_DISTANCE, payload);
+	sf40ReadCommand(lidar, LIDAR_FORWARD_OFFSET, payload);
 
-	return (int16_t)((payload[5] << 8) | payload[4]);
-}
+	return sf40DecodeOffset(payload);
+}/*sf40GetOffset*/
 
 
 /*! \brief Function can be used to set parameters for a specific alarm
  *
+ *  \param lidar handle of the lidar
+ * 
  *  \param alarmSettings Struct with alarm settings
  * 
  *  \param alarmNumber Select alarm number (1 to 7)
  */
-void setAlarm(alarm_t alarmSettings, lidar_alarm_t alarmNumber){
-	writeCommand(alarmNumber, &alarmSettings, 7);
-}/*setAlarm*/
+void sf40SetAlarm(sf40_t* lidar, alarm_t alarmSettings, lidar_alarm_t alarmNumber){
+	sf40WriteCommand(lidar, alarmNumber, &alarmSettings, 7);
+}/*sf40SetAlarm*/
 
 
 /*! \brief Function can be used to check parameters for a specific alarm
+ * 
+ *  \param lidar handle of the lidar
  * 
  *  \param alarmNumber Select alarm number (1 to 7)
  * 
  *  \return Struct with alarm settings
  */
-alarms_t checkAlarm(lidar_alarm_t alarmNumber){
+alarms_t sf40CheckAlarm(sf40_t* lidar, lidar_alarm_t alarmNumber){
 	uint8_t payload[7];  
-    readCommand(alarmNumber, payload);
+    sf40ReadCommand(lidar, alarmNumber, payload);
 
 	alarms_t alarms;
     alarms.byte = payload[4]; 
@@ -589,41 +1694,280 @@ alarms_t checkAlarm(lidar_alarm_t alarmNumber){
 }
 
 
-/*! \brief Establish serial connection with lidar
+/*! \brief Prepare the lock and condition used to hand responses from the reader thread to the caller
+ */
+static void initLidar(sf40_t* lidar){
+	pthread_condattr_t attributes;
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&lidar->responded, &attributes);
+	pthread_condattr_destroy(&attributes);
+	pthread_mutex_init(&lidar->lock, NULL);
+}/*initLidar*/
+
+
+/*! \brief Forget everything about the previous connection, the lock and condition are kept
+ *
+ *  \details The stream reader must not be running.
+ */
+static void resetLidar(sf40_t* lidar){
+	memset(&lidar->rxBuffer, 0, sizeof(lidar->rxBuffer));
+	memset(&lidar->parser, 0, sizeof(lidar->parser));
+	memset(&lidar->reader, 0, sizeof(lidar->reader));
+	memset(lidar->pending, 0, sizeof(lidar->pending));
+	memset(&lidar->alarms, 0, sizeof(lidar->alarms));
+}/*resetLidar*/
+
+
+/*! \brief Create a handle for a lidar that is reached through a transport
+ * 
+ *  \param transport connection to the lidar, the handle takes ownership of it
+ * 
+ *  \return handle to pass to the other sf40 functions, NULL if it couldn't be allocated
+ * 
+ *  \details Every handle owns its own transport, receive buffer and stream reader,
+ *           so different lidars can be serviced from different threads.
+ *           A single handle must not be used by more than one thread at a time.
+ */
+sf40_t* sf40OpenLidar(sf40Transport_t* transport){
+	if(transport == NULL) return NULL;
+
+	size_t size = (sizeof(sf40_t) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+	sf40_t* lidar = aligned_alloc(CACHE_LINE_SIZE, size);
+	if(lidar == NULL){
+		transport->close(transport);
+		return NULL;
+	}
+
+	memset(lidar, 0, sizeof(sf40_t));
+	lidar->transport = transport;
+	initLidar(lidar);
+	return lidar;
+}/*sf40OpenLidar*/
+
+
+/*! \brief Create a handle for a lidar and establish its serial connection
  * 
  *  \param port tty portname where the lidar is connected to
  * 
  *  \param baudrate select baudrate that the lidar is expecting
+ * 
+ *  \return handle to pass to the other sf40 functions, NULL if the port couldn't be opened
  */
-void setupLidar(const char* port, lidarBaudrate_t baudrate){
-	
-	switch(baudrate){
-		case LIDAR_115K2:
-			lidarCOM.baudrate = B115200;
-			break;
-		case LIDAR_230K4:
-			lidarCOM.baudrate = B230400;
-			break;
-		case LIDAR_460K8:
-			lidarCOM.baudrate = B460800;
-			break;
-		case LIDAR_921K6:
-			lidarCOM.baudrate = B921600;
-			break;
-		default:
-			lidarCOM.baudrate = B115200;
-			break;
-	}
-	
-	lidarCOM.devicePort = port;
-	setupDevice(&lidarCOM);
+sf40_t* sf40SetupLidar(const char* port, lidarBaudrate_t baudrate){
+	return sf40OpenLidar(sf40OpenSerial(port, baudrate));
+}/*sf40SetupLidar*/
+
+
+/*! \brief Close serial connection with lidar and free its handle
+ * 
+ *  \param lidar handle of the lidar
+ * 
+ *  \param lidar lidar that needs to be closed
+ */
+void sf40CloseLidar(sf40_t* lidar){
+	if(lidar == NULL || lidar->transport == NULL) return;
+
+	sf40StopStreamReader(lidar);
+	lidar->transport->close(lidar->transport);
+	lidar->transport = NULL;
+	if(lidar == &defaultLidar) return;
+
+	pthread_cond_destroy(&lidar->responded);
+	pthread_mutex_destroy(&lidar->lock);
+	free(lidar);
+}/*sf40CloseLidar*/
 
-	flushBuffer(&lidarCOM);
-}/*setupLidar*/
 
+/*
+ * Functions without a handle, these all use the lidar opened with setupLidar.
+ * Until it has been opened, or when opening it failed, they fail the same way they do when the lidar doesn't answer.
+ */
+
+static void initDefaultLidar(void){
+	initLidar(&defaultLidar);
+}/*initDefaultLidar*/
 
-/*! \brief Close serial connection with lidar
+/*! \brief Lidar used by the functions without a handle, with its lock and condition ready to use
  */
+static sf40_t* legacyLidar(void){
+	pthread_once(&defaultLidarOnce, initDefaultLidar);
+	return &defaultLidar;
+}/*legacyLidar*/
+
+
+int16_t readCommand(uint8_t command, uint8_t* payload){
+	return sf40ReadCommand(legacyLidar(), command, payload);
+}/*readCommand*/
+
+int writeCommand(uint8_t command, void* payload, uint16_t data_len){
+	return sf40WriteCommand(legacyLidar(), command, payload, data_len);
+}/*writeCommand*/
+
+int sendCommands(lidarCommand_t* commands, int count){
+	return sf40SendCommands(legacyLidar(), commands, count);
+}/*sendCommands*/
+
+int submitCommand(lidarCommand_t* command){
+	return sf40SubmitCommand(legacyLidar(), command);
+}/*submitCommand*/
+
+int16_t waitCommand(lidarCommand_t* command){
+	return sf40WaitCommand(legacyLidar(), command);
+}/*waitCommand*/
+
+int16_t pollCommand(lidarCommand_t* command){
+	return sf40PollCommand(legacyLidar(), command);
+}/*pollCommand*/
+
+int readAsync(lidarCommand_t* request, uint8_t command, uint8_t* response, sf40Completion_t completion, void* user){
+	return sf40ReadAsync(legacyLidar(), request, command, response, completion, user);
+}/*readAsync*/
+
+int writeAsync(lidarCommand_t* request, uint8_t command, const void* payload, uint16_t data_len, sf40Completion_t completion, void* user){
+	return sf40WriteAsync(legacyLidar(), request, command, payload, data_len, completion, user);
+}/*writeAsync*/
+
+void getName(char* name){
+	sf40GetName(legacyLidar(), name);
+}/*getName*/
+
+void getSerialNumber(char* serialNumber){
+	sf40GetSerialNumber(legacyLidar(), serialNumber);
+}/*getSerialNumber*/
+
+void sendUserData(uint8_t* data){
+	sf40SendUserData(legacyLidar(), data);
+}/*sendUserData*/
+
+void getUserData(uint8_t* data){
+	sf40GetUserData(legacyLidar(), data);
+}/*getUserData*/
+
+void setBaudrate(lidarBaudrate_t baudrate){
+	sf40SetBaudrate(legacyLidar(), baudrate);
+}/*setBaudrate*/
+
+uint16_t getToken(void){
+	return sf40GetToken(legacyLidar());
+}/*getToken*/
+
+void saveParameters(uint16_t token){
+	sf40SaveParameters(legacyLidar(), token);
+}/*saveParameters*/
+
+void restartLidar(uint16_t token){
+	sf40RestartLidar(legacyLidar(), token);
+}/*restartLidar*/
+
+float getVoltage(void){
+	return sf40GetVoltage(legacyLidar());
+}/*getVoltage*/
+
+float getMotorVoltage(void){
+	return sf40GetMotorVoltage(legacyLidar());
+}/*getMotorVoltage*/
+
+float getTemperature(void){
+	return sf40GetTemperature(legacyLidar());
+}/*getTemperature*/
+
+uint32_t getRevolutions(void){
+	return sf40GetRevolutions(legacyLidar());
+}/*getRevolutions*/
+
+void getAlarmState(alarms_t* alarms){
+	sf40GetAlarmState(legacyLidar(), alarms);
+}/*getAlarmState*/
+
+motorState_t getMotorState(void){
+	return sf40GetMotorState(legacyLidar());
+}/*getMotorState*/
+
+void enableStream(bool enabled){
+	sf40EnableStream(legacyLidar(), enabled);
+}/*enableStream*/
+
+uint8_t getStreamState(void){
+	return sf40GetStreamState(legacyLidar());
+}/*getStreamState*/
+
+int getStream(streamOutput_t* outputData){
+	return sf40GetStream(legacyLidar(), outputData);
+}/*getStream*/
+
+int acquireStream(streamView_t* view){
+	return sf40AcquireStream(legacyLidar(), view);
+}/*acquireStream*/
+
+void releaseStream(streamView_t* view){
+	sf40ReleaseStream(legacyLidar(), view);
+}/*releaseStream*/
+
+int startStreamReader(void){
+	return sf40StartStreamReader(legacyLidar());
+}/*startStreamReader*/
+
+void stopStreamReader(void){
+	sf40StopStreamReader(legacyLidar());
+}/*stopStreamReader*/
+
+void getStreamStats(streamStats_t* stats){
+	sf40GetStreamStats(legacyLidar(), stats);
+}/*getStreamStats*/
+
+void setAlarmHandler(sf40AlarmHandler_t handler, void* user){
+	sf40SetAlarmHandler(legacyLidar(), handler, user);
+}/*setAlarmHandler*/
+
+void enableLaser(bool enabled){
+	sf40EnableLaser(legacyLidar(), enabled);
+}/*enableLaser*/
+
+bool checkLaser(void){
+	return sf40CheckLaser(legacyLidar());
+}/*checkLaser*/
+
+void setOutputRate(lidarOutputRate_t outputRate){
+	sf40SetOutputRate(legacyLidar(), outputRate);
+}/*setOutputRate*/
+
+lidarOutputRate_t getOutputRate(void){
+	return sf40GetOutputRate(legacyLidar());
+}/*getOutputRate*/
+
+void getDistance(writeDistance_t distanceSettings, readDistance_t* receivedDistances){
+	sf40GetDistance(legacyLidar(), distanceSettings, receivedDistances);
+}/*getDistance*/
+
+void setOffset(int16_t offset){
+	sf40SetOffset(legacyLidar(), offset);
+}/*setOffset*/
+
+int16_t getOffset(void){
+	return sf40GetOffset(legacyLidar());
+}/*getOffset*/
+
+void setAlarm(alarm_t alarmSettings, lidar_alarm_t alarmNumber){
+	sf40SetAlarm(legacyLidar(), alarmSettings, alarmNumber);
+}/*setAlarm*/
+
+alarms_t checkAlarm(lidar_alarm_t alarmNumber){
+	return sf40CheckAlarm(legacyLidar(), alarmNumber);
+}/*checkAlarm*/
+
+int setupLidar(const char* port, lidarBaudrate_t baudrate){
+	sf40_t* lidar = legacyLidar();
+	sf40CloseLidar(lidar);
+	resetLidar(lidar);
+
+	lidar->transport = sf40OpenSerial(port, baudrate);
+	if(lidar->transport == NULL) return -1;
+
+	rxFlush(lidar);
+	return 0;
+}/*setupLidar*/
+
 void closeLidar(void){
-	closeDevice(&lidarCOM, true);
-}
\ No newline at end of file
+	sf40CloseLidar(legacyLidar());
+}/*closeLidar*/
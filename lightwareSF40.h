@@ -6,14 +6,25 @@
     #include <unistd.h>
     #include <stdbool.h>
     #include <string.h>
-
-    #include "../RPI-serial/RPIserial.h"
+    #include <errno.h>
 
     #define MAX_RESPONSE_SIZE 1028
+    #define RX_BUFFER_SIZE    4096          // Receive ring buffer size, must be a power of 2 and hold at least one full packet
     #define STARTBIT 0XAA
+    #define COMMAND_TIMEOUT_US 100000       // Time to wait for the response on a command [us]
+
+    #define BATCH_SIZE         1024         // Largest amount of bytes send with a single write by sendCommands
+
+    // Most distances a stream packet can hold: MAX_RESPONSE_SIZE minus 18 header and 2 checksum bytes.
+    // It sets the size of streamOutput_t, so it can't be overridden: the library and the program have to agree on it.
+    #define SF40_MAX_STREAM_POINTS ((MAX_RESPONSE_SIZE - 20) / 2)
+
+    #define STREAM_QUEUE_SIZE  16           // Received stream packets that can be queued, must be a power of 2
+    #define READER_WAKEUP_US   10000        // Longest time the stream reader sleeps before checking if it has to stop [us]
+    #define CACHE_LINE_SIZE    64
 
     #define MODEL_NUMBER        "SF40"
-    #define LIDAR_VOLTAGE(counts)    ((uint32_t)counts / 4095.0) * 2.048 * 5.7
+    #define LIDAR_VOLTAGE(counts)    (((uint32_t)(counts) / 4095.0) * 2.048 * 5.7)
 
 
     // Commands for the Lidar
@@ -95,9 +106,22 @@
         uint16_t    pointTotal;             // Total number of points this revolution.
         uint16_t    pointCount;             // Number of points in this packet.
         uint16_t    pointStartIndex;        // Index of the first point in this packet.
-        int16_t     pointDistances[200];    // Array of distances [cm] for each point.
+        int16_t     pointDistances[SF40_MAX_STREAM_POINTS];    // Array of distances [cm] for each point.
     }streamOutput_t;
 
+    typedef struct{
+        alarms_t    alarmState;             // State of each alarm as described in Alarm state [111]
+        uint16_t    pps;                    // Points per second
+        int16_t     forwardOffset;          // Orientation offset as described in Forward offset [109]
+        int16_t     motorVoltage;           // Motor voltage as described in Motor voltage [107]
+        uint8_t     revolutionIndex;        // Increments as each new revolution begins. Note that this value wraps to 0 after 255.
+        uint16_t    pointTotal;             // Total number of points this revolution.
+        uint16_t    pointCount;             // Number of points in this packet.
+        uint16_t    pointStartIndex;        // Index of the first point in this packet.
+        const uint8_t* distances;           // pointCount little endian 16 bit distances [cm], valid until the view is released
+        const uint8_t* packet;              // Whole received packet, valid until the view is released
+    }streamView_t;
+
     typedef struct{
         int16_t     averageDistance;    // Average distance [cm]
         int16_t     closestDistance;    // Closest distance [cm]
@@ -119,6 +143,121 @@
         int16_t distance;       // Distance at which alarm is triggered.
     }alarm_t;
 
+    typedef struct lidarCommand lidarCommand_t;
+
+    // Called once a submitted command has its result, user is the pointer set in the command
+    typedef void (*sf40Completion_t)(lidarCommand_t* command, void* user);
+
+    struct lidarCommand{
+        uint8_t     command;            // Command to read from or write to
+        bool        write;              // true to write payload to the command, false to read it
+        const void* payload;            // Data to write
+        uint16_t    length;             // Number of bytes in payload
+        uint8_t*    response;           // Location where the response packet is saved, can be NULL
+        int16_t     result;             // Bytes in the response packet, 0 while waiting for it, -1 when no response was received
+        sf40Completion_t completion;    // Called when the result is known, can be NULL
+        void*       user;               // Passed to completion
+        uint64_t    deadline;           // Monotonic time [us] at which the command fails, set when it is send
+    };
+
+    typedef struct{
+        uint32_t    depthHighWater;     // Highest number of packets that were waiting in the stream reader queue
+        uint32_t    dropped;            // Packets dropped because the stream reader queue was full
+        uint32_t    crcErrors;          // Packets rejected because their checksum didn't match
+        uint32_t    lengthErrors;       // Packets rejected because their length can't be right
+        uint32_t    lostPoints;         // Stream points that never reached the queue, found from the revolution and start index of each packet
+        uint32_t    lostRevolutions;    // Revolutions of which not a single stream packet reached the queue
+    }streamStats_t;
+
+    // Handle to a single lidar, created by sf40SetupLidar or sf40OpenLidar
+    typedef struct sf40 sf40_t;
+
+    // Connection to a lidar, see lightwareSF40Transport.h
+    typedef struct sf40Transport sf40Transport_t;
+
+    // Change of the alarm state between two stream packets
+    typedef struct{
+        alarms_t    state;              // Alarm state in the packet
+        alarms_t    rising;             // Alarms that went on with this packet
+        alarms_t    falling;            // Alarms that went off with this packet
+        uint64_t    timestamp;          // Monotonic time [us] at which the packet was received
+        uint8_t     revolutionIndex;    // Revolution index of the packet
+        uint16_t    pointStartIndex;    // Index of the first point in the packet
+    }alarmEvent_t;
+
+    // Called by whoever receives the stream packets, the stream reader thread when it is running
+    typedef void (*sf40AlarmHandler_t)(sf40_t* lidar, const alarmEvent_t* event, void* user);
+
+    sf40_t* sf40SetupLidar(const char* port, lidarBaudrate_t baudrate);
+    sf40_t* sf40OpenLidar(sf40Transport_t* transport);
+    void sf40CloseLidar(sf40_t* lidar);
+
+    int16_t sf40ReadCommand(sf40_t* lidar, uint8_t command, uint8_t* payload);
+    int sf40WriteCommand(sf40_t* lidar, uint8_t command, void* payload, uint16_t data_len);
+    int sf40SendCommands(sf40_t* lidar, lidarCommand_t* commands, int count);
+    int sf40SubmitCommand(sf40_t* lidar, lidarCommand_t* command);
+    int16_t sf40WaitCommand(sf40_t* lidar, lidarCommand_t* command);
+    int16_t sf40PollCommand(sf40_t* lidar, lidarCommand_t* command);
+    int sf40ReadAsync(sf40_t* lidar, lidarCommand_t* request, uint8_t command, uint8_t* response, sf40Completion_t completion, void* user);
+    int sf40WriteAsync(sf40_t* lidar, lidarCommand_t* request, uint8_t command, const void* payload, uint16_t data_len, sf40Completion_t completion, void* user);
+
+    // Decode the response packet of an asynchronous read, these give the same value as the matching getter
+    uint16_t sf40DecodeToken(const uint8_t* response);
+    float sf40DecodeVoltage(const uint8_t* response);
+    float sf40DecodeMotorVoltage(const uint8_t* response);
+    float sf40DecodeTemperature(const uint8_t* response);
+    uint32_t sf40DecodeRevolutions(const uint8_t* response);
+    alarms_t sf40DecodeAlarmState(const uint8_t* response);
+    motorState_t sf40DecodeMotorState(const uint8_t* response);
+    bool sf40DecodeLaser(const uint8_t* response);
+    lidarOutputRate_t sf40DecodeOutputRate(const uint8_t* response);
+    void sf40DecodeDistance(const uint8_t* response, readDistance_t* receivedDistances);
+    int16_t sf40DecodeOffset(const uint8_t* response);
+
+    void sf40GetName(sf40_t* lidar, char* name);
+    void sf40GetSerialNumber(sf40_t* lidar, char* serialNumber);
+    void sf40SendUserData(sf40_t* lidar, uint8_t* data);
+    void sf40GetUserData(sf40_t* lidar, uint8_t* data);
+
+    void sf40SetBaudrate(sf40_t* lidar, lidarBaudrate_t baudrate);
+    
+    uint16_t sf40GetToken(sf40_t* lidar);
+    void sf40SaveParameters(sf40_t* lidar, uint16_t token);
+    void sf40RestartLidar(sf40_t* lidar, uint16_t token);
+
+    float sf40GetVoltage(sf40_t* lidar);
+    float sf40GetMotorVoltage(sf40_t* lidar);
+    float sf40GetTemperature(sf40_t* lidar);
+    uint32_t sf40GetRevolutions(sf40_t* lidar);
+    void sf40GetAlarmState(sf40_t* lidar, alarms_t* alarms);
+    motorState_t sf40GetMotorState(sf40_t* lidar);
+    
+    void sf40EnableStream(sf40_t* lidar, bool enabled);
+    uint8_t sf40GetStreamState(sf40_t* lidar);
+    int sf40GetStream(sf40_t* lidar, streamOutput_t* outputData);
+    int sf40AcquireStream(sf40_t* lidar, streamView_t* view);
+    void sf40ReleaseStream(sf40_t* lidar, streamView_t* view);
+
+    int sf40StartStreamReader(sf40_t* lidar);
+    void sf40StopStreamReader(sf40_t* lidar);
+    void sf40GetStreamStats(sf40_t* lidar, streamStats_t* stats);
+    void sf40SetAlarmHandler(sf40_t* lidar, sf40AlarmHandler_t handler, void* user);
+
+    void sf40EnableLaser(sf40_t* lidar, bool enabled);
+    bool sf40CheckLaser(sf40_t* lidar);
+
+    void sf40SetOutputRate(sf40_t* lidar, lidarOutputRate_t outputRate);
+    lidarOutputRate_t sf40GetOutputRate(sf40_t* lidar);
+
+    void sf40GetDistance(sf40_t* lidar, writeDistance_t distanceSettings, readDistance_t* receivedDistances);
+
+    void sf40SetOffset(sf40_t* lidar, int16_t offset);
+    int16_t sf40GetOffset(sf40_t* lidar);
+
+    void sf40SetAlarm(sf40_t* lidar, alarm_t alarmSettings, lidar_alarm_t alarmNumber);
+    alarms_t sf40CheckAlarm(sf40_t* lidar, lidar_alarm_t alarmNumber);
+
+    // Functions without a handle, these use the lidar opened with setupLidar
     void getName(char* name);
     void getSerialNumber(char* serialNumber);
     void sendUserData(uint8_t* data);
@@ -140,6 +279,13 @@
     void enableStream(bool enabled);
     uint8_t getStreamState(void);
     int getStream(streamOutput_t* outputData);
+    int acquireStream(streamView_t* view);
+    void releaseStream(streamView_t* view);
+
+    int startStreamReader(void);
+    void stopStreamReader(void);
+    void getStreamStats(streamStats_t* stats);
+    void setAlarmHandler(sf40AlarmHandler_t handler, void* user);
 
     void enableLaser(bool enabled);
     bool checkLaser(void);
@@ -155,7 +301,16 @@
     void setAlarm(alarm_t alarmSettings, lidar_alarm_t alarmNumber);
     alarms_t checkAlarm(lidar_alarm_t alarmNumber);
 
-    void setupLidar(const char* port, lidarBaudrate_t baudrate);
+    int16_t readCommand(uint8_t command, uint8_t* payload);
+    int writeCommand(uint8_t command, void* payload, uint16_t data_len);
+    int sendCommands(lidarCommand_t* commands, int count);
+    int submitCommand(lidarCommand_t* command);
+    int16_t waitCommand(lidarCommand_t* command);
+    int16_t pollCommand(lidarCommand_t* command);
+    int readAsync(lidarCommand_t* request, uint8_t command, uint8_t* response, sf40Completion_t completion, void* user);
+    int writeAsync(lidarCommand_t* request, uint8_t command, const void* payload, uint16_t data_len, sf40Completion_t completion, void* user);
+
+    int setupLidar(const char* port, lidarBaudrate_t baudrate);
     void closeLidar(void);
 
     //#define DEBUG
@@ -0,0 +1,301 @@
+/*!
+ *  \file    lightwareSF40CRC.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Checksum used in every packet to and from the lidar (CRC-16/XMODEM, polynomial 0x1021)
+ */
+
+#include "lightwareSF40CRC.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define CRC_CLMUL_X86
+#elif defined(__aarch64__) && defined(__linux__)
+	#include <arm_neon.h>
+	#include <sys/auxv.h>
+	#include <asm/hwcap.h>
+	#define CRC_CLMUL_ARM
+#endif
+
+#define CRC_FOLD_MINIMUM 64		// Smallest amount of bytes worth folding with carry-less multiplies
+#define CRC_FOLD_K1      0x650B	// x^192 mod 0x11021
+#define CRC_FOLD_K2      0xAEFC	// x^128 mod 0x11021
+
+typedef uint16_t (*crcKernel_t)(uint16_t crc, const uint8_t* data, size_t size);
+
+// crcTable[k][b] is the checksum of byte b followed by k zero bytes
+static uint16_t crcTable[8][256];
+
+// Set when the cpu can multiply without carries
+static bool crcHasClmul;
+
+
+/*! \brief Calculate checksum one bit at a time
+ *  
+ *  \param crc checksum of the bytes before data
+ * 
+ *  \param data bytes to add to the checksum
+ * 
+ *  \param size number of bytes in data
+ * 
+ *  \return checksum including data
+ */
+static uint16_t crcBitwise(uint16_t crc, const uint8_t* data, size_t size){
+	for(size_t i = 0; i < size; ++i){
+		uint16_t code = crc >> 8;
+		code ^= data[i];
+		code ^= code >> 4;
+		crc = crc << 8;
+		crc ^= code;
+		code = code << 5;
+		crc ^= code;
+		code = code << 7;
+		crc ^= code;
+	}
+	return crc;
+}/*crcBitwise*/
+
+
+/*! \brief Fill the lookup tables and check what the cpu supports
+ *
+ *  \details Runs once when the library is loaded, before main, so the kernels use the tables without checking for them.
+ */
+__attribute__((constructor))
+static void buildTables(void){
+	#if defined(CRC_CLMUL_X86)
+	__builtin_cpu_init();
+	crcHasClmul = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+	#elif defined(CRC_CLMUL_ARM)
+	crcHasClmul = (getauxval(AT_HWCAP) & HWCAP_PMULL) != 0;
+	#endif
+
+	for(int b = 0; b < 256; b++){
+		uint8_t byte = b;
+		crcTable[0][b] = crcBitwise(0, &byte, 1);
+	}
+	for(int k = 1; k < 8; k++){
+		for(int b = 0; b < 256; b++){
+			uint16_t previous = crcTable[k - 1][b];
+			crcTable[k][b] = (previous << 8) ^ crcTable[0][previous >> 8];
+		}
+	}
+}/*buildTables*/
+
+
+/*! \brief Calculate checksum with one table lookup per byte, two bytes per step
+ *
+ *  \details The lookups of both bytes only depend on the checksum before the step, so they don't
+ *           have to wait for each other like they do when every byte is looked up on its own.
+ */
+static uint16_t crcTableLookup(uint16_t crc, const uint8_t* data, size_t size){
+	while(size >= 2){
+		crc = crcTable[1][data[0] ^ (crc >> 8)] ^ crcTable[0][data[1] ^ (crc & 0xFF)];
+		data += 2;
+		size -= 2;
+	}
+	if(size > 0) crc = (crc << 8) ^ crcTable[0][(crc >> 8) ^ data[0]];
+	return crc;
+}/*crcTableLookup*/
+
+
+/*! \brief Calculate checksum eight bytes at a time
+ *
+ *  \details The checksum only affects the first two bytes of each block, the other six
+ *           are looked up on their own and all eight results are xored together.
+ */
+static uint16_t crcSlice8(uint16_t crc, const uint8_t* data, size_t size){
+	while(size >= 8){
+		crc = crcTable[7][data[0] ^ (crc >> 8)] ^ crcTable[6][data[1] ^ (crc & 0xFF)] ^
+			  crcTable[5][data[2]] ^ crcTable[4][data[3]] ^
+			  crcTable[3][data[4]] ^ crcTable[2][data[5]] ^
+			  crcTable[1][data[6]] ^ crcTable[0][data[7]];
+		data += 8;
+		size -= 8;
+	}
+	for(size_t i = 0; i < size; i++){
+		crc = (crc << 8) ^ crcTable[0][(crc >> 8) ^ data[i]];
+	}
+	return crc;
+}/*crcSlice8*/
+
+
+#if defined(CRC_CLMUL_X86)
+/*! \brief Reduce whole 16 byte blocks with carry-less multiplies
+ *
+ *  \param crc checksum of the bytes before data
+ * 
+ *  \param data bytes to add to the checksum, at least 16
+ * 
+ *  \param blocks number of 16 byte blocks to reduce
+ * 
+ *  \param folded location for the 16 byte remainder, it has the same checksum as the blocks
+ *
+ *  \details Each block is byte swapped so bit 127 is the highest power of x. The accumulator is moved
+ *           128 bits up by multiplying its two halves with x^192 and x^128 mod P, which keeps it congruent
+ *           to everything folded so far while it never grows past 128 bits.
+ */
+__attribute__((target("pclmul,ssse3")))
+static void crcFold(uint16_t crc, const uint8_t* data, size_t blocks, uint8_t* folded){
+	const __m128i swap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i constants = _mm_set_epi64x(CRC_FOLD_K2, CRC_FOLD_K1);
+
+	__m128i accumulator = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)data), swap);
+	accumulator = _mm_xor_si128(accumulator, _mm_set_epi64x((int64_t)((uint64_t)crc << 48), 0));
+
+	for(size_t i = 1; i < blocks; i++){
+		__m128i block = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)&data[i * 16]), swap);
+		__m128i high  = _mm_clmulepi64_si128(accumulator, constants, 0x01);
+		__m128i low   = _mm_clmulepi64_si128(accumulator, constants, 0x10);
+		accumulator = _mm_xor_si128(block, _mm_xor_si128(high, low));
+	}
+
+	_mm_storeu_si128((__m128i*)folded, _mm_shuffle_epi8(accumulator, swap));
+}/*crcFold*/
+#elif defined(CRC_CLMUL_ARM)
+/*! \brief Reduce whole 16 byte blocks with carry-less multiplies
+ *
+ *  \details Same folding as the x86 version, with PMULL.
+ */
+__attribute__((target("+crypto")))
+static void crcFold(uint16_t crc, const uint8_t* data, size_t blocks, uint8_t* folded){
+	uint8x16_t first = vrev64q_u8(vld1q_u8(data));
+	uint64x2_t accumulator = vreinterpretq_u64_u8(vextq_u8(first, first, 8));
+	accumulator = veorq_u64(accumulator, vcombine_u64(vcreate_u64(0), vcreate_u64((uint64_t)crc << 48)));
+
+	for(size_t i = 1; i < blocks; i++){
+		uint8x16_t bytes = vrev64q_u8(vld1q_u8(&data[i * 16]));
+		uint64x2_t block = vreinterpretq_u64_u8(vextq_u8(bytes, bytes, 8));
+		poly128_t  high  = vmull_p64((poly64_t)vgetq_lane_u64(accumulator, 1), (poly64_t)CRC_FOLD_K1);
+		poly128_t  low   = vmull_p64((poly64_t)vgetq_lane_u64(accumulator, 0), (poly64_t)CRC_FOLD_K2);
+		accumulator = veorq_u64(block, veorq_u64(vreinterpretq_u64_p128(high), vreinterpretq_u64_p128(low)));
+	}
+
+	uint8x16_t result = vrev64q_u8(vreinterpretq_u8_u64(accumulator));
+	vst1q_u8(folded, vextq_u8(result, result, 8));
+}/*crcFold*/
+#endif
+
+
+/*! \brief Calculate checksum with carry-less multiplies, for large buffers like recorded streams
+ *
+ *  \details The blocks are folded into 16 bytes that have the same checksum, those and the bytes
+ *           after the last whole block are finished with the tables. Short buffers and cpus without
+ *           carry-less multiply use slicing-by-8 only.
+ */
+static uint16_t crcClmul(uint16_t crc, const uint8_t* data, size_t size){
+	#if defined(CRC_CLMUL_X86) || defined(CRC_CLMUL_ARM)
+	if(crcHasClmul && size >= CRC_FOLD_MINIMUM){
+		uint8_t folded[16];
+		size_t blocks = size / 16;
+		crcFold(crc, data, blocks, folded);
+
+		crc = crcSlice8(0, folded, 16);
+		return crcSlice8(crc, &data[blocks * 16], size - blocks * 16);
+	}
+	#endif
+	return crcSlice8(crc, data, size);
+}/*crcClmul*/
+
+
+static const crcKernel_t crcKernels[] = {
+	[SF40_CRC_BITWISE] = crcBitwise,
+	[SF40_CRC_TABLE]   = crcTableLookup,
+	[SF40_CRC_SLICE8]  = crcSlice8,
+	[SF40_CRC_CLMUL]   = crcClmul
+};
+
+static _Atomic sf40CrcMethod_t crcMethod = SF40_CRC_CLMUL;
+
+
+/*! \brief Continue a checksum with more bytes
+ *  
+ *  \param crc checksum of the bytes before data, 0 to start a new one
+ * 
+ *  \param data bytes to add to the checksum
+ * 
+ *  \param size number of bytes in data
+ * 
+ *  \return checksum including data
+ */
+uint16_t sf40UpdateCRC(uint16_t crc, const uint8_t* data, size_t size){
+	return crcKernels[atomic_load_explicit(&crcMethod, memory_order_relaxed)](crc, data, size);
+}/*sf40UpdateCRC*/
+
+
+/*! \brief Calculate checksum for lidar data
+ *  
+ *  \param Data Data that has been received / is going to be send to the lidar
+ * 
+ *  \param Size Number of bytes in package
+ * 
+ *  \return returns 2 byte checksum
+ */
+uint16_t createCRC(uint8_t* data, uint16_t size){
+	return sf40UpdateCRC(0, data, size);
+} /*createCRC*/
+
+
+/*! \brief Start a checksum that is build up in pieces
+ *  
+ *  \param state checksum state
+ */
+void sf40CrcInit(sf40Crc_t* state){
+	state->crc = 0;
+}/*sf40CrcInit*/
+
+
+/*! \brief Add the next piece of data to a checksum
+ *  
+ *  \param state checksum state
+ * 
+ *  \param data bytes that follow the ones added before
+ * 
+ *  \param size number of bytes in data
+ */
+void sf40CrcUpdate(sf40Crc_t* state, const uint8_t* data, size_t size){
+	state->crc = sf40UpdateCRC(state->crc, data, size);
+}/*sf40CrcUpdate*/
+
+
+/*! \brief Checksum of everything that has been added
+ *  
+ *  \param state checksum state
+ * 
+ *  \return 2 byte checksum, the same createCRC gives over all pieces at once
+ */
+uint16_t sf40CrcFinal(const sf40Crc_t* state){
+	return state->crc;
+}/*sf40CrcFinal*/
+
+
+/*! \brief Select how checksums are calculated
+ *  
+ *  \param method method to use from now on
+ * 
+ *  \retval  0 : method has been selected
+ *  \retval -1 : unknown method, or the cpu can't multiply without carries
+ * 
+ *  \details Every method gives the same checksum. SF40_CRC_CLMUL is the default,
+ *           on cpus without carry-less multiply it uses slicing-by-8.
+ */
+int sf40SetCrcMethod(sf40CrcMethod_t method){
+	if((unsigned)method >= sizeof(crcKernels) / sizeof(crcKernels[0])) return -1;
+
+	if(method == SF40_CRC_CLMUL && !crcHasClmul) return -1;
+
+	atomic_store_explicit(&crcMethod, method, memory_order_relaxed);
+	return 0;
+}/*sf40SetCrcMethod*/
+
+
+/*! \brief Method that is used to calculate checksums
+ */
+sf40CrcMethod_t sf40GetCrcMethod(void){
+	sf40CrcMethod_t method = atomic_load_explicit(&crcMethod, memory_order_relaxed);
+	if(method == SF40_CRC_CLMUL && !crcHasClmul) return SF40_CRC_SLICE8;
+	return method;
+}/*sf40GetCrcMethod*/
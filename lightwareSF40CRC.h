@@ -0,0 +1,30 @@
+#ifndef _SF40_CRC_H_
+#define _SF40_CRC_H_
+
+    #include <stdint.h>
+    #include <stddef.h>
+
+    // Ways to calculate the checksum, all of them give the same result
+    typedef enum {
+        SF40_CRC_BITWISE    = 0,    // Shift and xor per byte, no tables
+        SF40_CRC_TABLE      = 1,    // One table lookup per byte, two bytes per step
+        SF40_CRC_SLICE8     = 2,    // Eight bytes per step with eight tables
+        SF40_CRC_CLMUL      = 3     // Carry-less multiply folding on large buffers, when the cpu supports it
+    } sf40CrcMethod_t;
+
+    // Checksum that is build up in pieces, as the bytes arrive
+    typedef struct{
+        uint16_t crc;                   // Checksum of all bytes added so far
+    }sf40Crc_t;
+
+    uint16_t createCRC(uint8_t* data, uint16_t size);
+    uint16_t sf40UpdateCRC(uint16_t crc, const uint8_t* data, size_t size);
+
+    void sf40CrcInit(sf40Crc_t* state);
+    void sf40CrcUpdate(sf40Crc_t* state, const uint8_t* data, size_t size);
+    uint16_t sf40CrcFinal(const sf40Crc_t* state);
+
+    int sf40SetCrcMethod(sf40CrcMethod_t method);
+    sf40CrcMethod_t sf40GetCrcMethod(void);
+
+#endif
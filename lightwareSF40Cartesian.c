@@ -0,0 +1,247 @@
+/*!
+ *  \file    lightwareSF40Cartesian.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Conversion of stream packets and complete scans to x/y coordinates,
+ *           using tables of cos and sin that are kept for as long as the revolution doesn't change
+ */
+
+#include "lightwareSF40Cartesian.h"
+#include "lightwareSF40Simd.h"
+#include <math.h>
+
+typedef void (*rotateKernel_t)(float* x, float* y, const float* cosTable, const float* sinTable, uint16_t count);
+
+
+/*! \brief Turn distances into x/y with the cos and sin of their angles, one point at a time
+ *
+ *  \param x distances [m] on entry, x [m] on return
+ *
+ *  \param y location for the y [m] of every point
+ */
+static void rotateScalar(float* x, float* y, const float* cosTable, const float* sinTable, uint16_t count){
+	for(uint16_t i = 0; i < count; i++){
+		y[i] = x[i] * sinTable[i];
+		x[i] = x[i] * cosTable[i];
+	}
+}/*rotateScalar*/
+
+
+#if defined(SF40_SIMD_X86)
+/*! \brief Turn distances into x/y, 4 points at a time
+ */
+__attribute__((target("sse2")))
+static void rotateSse2(float* x, float* y, const float* cosTable, const float* sinTable, uint16_t count){
+	uint16_t i = 0;
+	for(; i + 4 <= count; i += 4){
+		__m128 meters = _mm_loadu_ps(&x[i]);
+		_mm_storeu_ps(&y[i], _mm_mul_ps(meters, _mm_loadu_ps(&sinTable[i])));
+		_mm_storeu_ps(&x[i], _mm_mul_ps(meters, _mm_loadu_ps(&cosTable[i])));
+	}
+	rotateScalar(&x[i], &y[i], &cosTable[i], &sinTable[i], count - i);
+}/*rotateSse2*/
+
+
+/*! \brief Turn distances into x/y, 8 points at a time
+ */
+__attribute__((target("avx2")))
+static void rotateAvx2(float* x, float* y, const float* cosTable, const float* sinTable, uint16_t count){
+	uint16_t i = 0;
+	for(; i + 8 <= count; i += 8){
+		__m256 meters = _mm256_loadu_ps(&x[i]);
+		_mm256_storeu_ps(&y[i], _mm256_mul_ps(meters, _mm256_loadu_ps(&sinTable[i])));
+		_mm256_storeu_ps(&x[i], _mm256_mul_ps(meters, _mm256_loadu_ps(&cosTable[i])));
+	}
+	rotateSse2(&x[i], &y[i], &cosTable[i], &sinTable[i], count - i);
+}/*rotateAvx2*/
+#endif
+
+
+#if defined(SF40_SIMD_NEON)
+/*! \brief Turn distances into x/y, 4 points at a time
+ */
+static void rotateNeon(float* x, float* y, const float* cosTable, const float* sinTable, uint16_t count){
+	uint16_t i = 0;
+	for(; i + 4 <= count; i += 4){
+		float32x4_t meters = vld1q_f32(&x[i]);
+		vst1q_f32(&y[i], vmulq_f32(meters, vld1q_f32(&sinTable[i])));
+		vst1q_f32(&x[i], vmulq_f32(meters, vld1q_f32(&cosTable[i])));
+	}
+	rotateScalar(&x[i], &y[i], &cosTable[i], &sinTable[i], count - i);
+}/*rotateNeon*/
+#endif
+
+
+// Kernels of every instruction set, SF40_KERNEL picks the one the cpu supports
+static const rotateKernel_t rotateKernels[SF40_SIMD_LEVELS] = {
+	[SF40_SIMD_SCALAR] = rotateScalar,
+	#if defined(SF40_SIMD_X86)
+	[SF40_SIMD_SSE2]   = rotateSse2,
+	[SF40_SIMD_AVX2]   = rotateAvx2,
+	#elif defined(SF40_SIMD_NEON)
+	[SF40_SIMD_NEON]   = rotateNeon,
+	#endif
+};
+
+
+/*! \brief Prepare an angle table for its first use
+ *
+ *  \param table table that needs to be prepared
+ */
+void sf40AngleTableInit(sf40AngleTable_t* table){
+	table->ready = false;
+	table->pointTotal = 0;
+	table->forwardOffset = 0;
+}/*sf40AngleTableInit*/
+
+
+/*! \brief Make sure the angle table belongs to a revolution
+ *
+ *  \param table table of cos and sin values
+ *
+ *  \param pointTotal number of points in the revolution
+ *
+ *  \param forwardOffset forward offset [deg] of the revolution
+ *
+ *  \retval  1 : the table has been rebuild
+ *  \retval  0 : the table already belonged to this revolution
+ *  \retval -1 : pointTotal is 0 or larger than SF40_MAX_SCAN_POINTS
+ *
+ *  \details Point i lies at an angle of i * 360 / pointTotal + forwardOffset degrees. Its x lies along cos and y along sin
+ *           of that angle. The table is only rebuild when pointTotal or forwardOffset changes,
+ *           which happens when the update rate or forward offset of the lidar is changed.
+ */
+int sf40PrepareAngles(sf40AngleTable_t* table, uint16_t pointTotal, int16_t forwardOffset){
+	if(pointTotal == 0 || pointTotal > SF40_MAX_SCAN_POINTS) return -1;
+	if(table->ready && table->pointTotal == pointTotal && table->forwardOffset == forwardOffset) return 0;
+
+	double step = 2.0 * M_PI / pointTotal;
+	double offset = forwardOffset * M_PI / 180.0;
+	for(uint16_t i = 0; i < pointTotal; i++){
+		double angle = i * step + offset;
+		table->cosTable[i] = (float)cos(angle);
+		table->sinTable[i] = (float)sin(angle);
+	}
+
+	table->pointTotal = pointTotal;
+	table->forwardOffset = forwardOffset;
+	table->ready = true;
+	return 1;
+}/*sf40PrepareAngles*/
+
+
+/*! \brief Convert a part of a revolution to x/y
+ *
+ *  \param raw little endian distances [cm] of the points from pointStartIndex on
+ *
+ *  \retval Amount of valid points
+ *  \retval -1 : the points don't fit in the revolution or pointTotal is larger than SF40_MAX_SCAN_POINTS
+ *
+ *  \details The distances are converted to meters and the validity mask made by sf40DistancesToMeters, straight into x,
+ *           which is then multiplied by the cos and sin of every point.
+ */
+static int32_t convertFragment(sf40AngleTable_t* table, uint16_t pointTotal, int16_t forwardOffset, uint16_t pointStartIndex,
+							   uint16_t pointCount, const uint8_t* raw, float* x, float* y, uint8_t* valid){
+	if(sf40PrepareAngles(table, pointTotal, forwardOffset) < 0) return -1;
+	if((uint32_t)pointStartIndex + pointCount > pointTotal) return -1;
+
+	uint16_t valids = sf40DistancesToMeters(raw, pointCount, x, valid);
+	SF40_KERNEL(rotateKernels)(x, y, &table->cosTable[pointStartIndex], &table->sinTable[pointStartIndex], pointCount);
+	return valids;
+}/*convertFragment*/
+
+
+/*! \brief Convert a complete scan to x/y
+ *
+ *  \param table angle table, rebuild when it doesn't belong to the scan
+ *
+ *  \param scan scan from sf40ScanLatest
+ *
+ *  \param x location for the x [m] of every point, must hold pointTotal floats
+ *
+ *  \param y location for the y [m] of every point, must hold pointTotal floats
+ *
+ *  \param valid location for the validity mask, must hold SF40_VALID_BYTES(pointTotal) bytes, can be NULL
+ *
+ *  \retval Amount of valid points
+ *  \retval -1 : pointTotal of the scan is larger than SF40_MAX_SCAN_POINTS
+ *
+ *  \details A point is valid when its distance isn't negative and it has been received in this scan.
+ */
+int32_t sf40ScanToCartesian(sf40AngleTable_t* table, const sf40Scan_t* scan, float* x, float* y, uint8_t* valid){
+	uint8_t mask[SF40_VALID_BYTES(SF40_MAX_SCAN_POINTS)];
+	if(valid == NULL) valid = mask;
+
+	#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	const uint8_t* raw = (const uint8_t*)scan->distances;
+	#else
+	uint8_t raw[SF40_MAX_SCAN_POINTS * 2];
+	for(uint16_t i = 0; i < scan->pointTotal && i < SF40_MAX_SCAN_POINTS; i++){
+		raw[i*2]     = (uint8_t)scan->distances[i];
+		raw[(i*2)+1] = (uint8_t)((uint16_t)scan->distances[i] >> 8);
+	}
+	#endif
+
+	if(convertFragment(table, scan->pointTotal, scan->forwardOffset, 0, scan->pointTotal, raw, x, y, valid) < 0) return -1;
+
+	int32_t valids = 0;
+	for(uint16_t i = 0; i < SF40_VALID_BYTES(scan->pointTotal); i++){
+		valid[i] &= scan->coverage[i];
+		valids += __builtin_popcount(valid[i]);
+	}
+	return valids;
+}/*sf40ScanToCartesian*/
+
+
+/*! \brief Convert a packet from acquireStream to x/y
+ *
+ *  \param table angle table, rebuild when it doesn't belong to the revolution of the packet
+ *
+ *  \param view packet from acquireStream
+ *
+ *  \param x location for the x [m] of every point, must hold pointCount floats
+ *
+ *  \param y location for the y [m] of every point, must hold pointCount floats
+ *
+ *  \param valid location for the validity mask, must hold SF40_VALID_BYTES(pointCount) bytes, can be NULL
+ *
+ *  \retval Amount of valid points
+ *  \retval -1 : the packet holds more than SF40_MAX_STREAM_POINTS points, or doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS
+ */
+int32_t sf40ViewToCartesian(sf40AngleTable_t* table, const streamView_t* view, float* x, float* y, uint8_t* valid){
+	if(view->pointCount > SF40_MAX_STREAM_POINTS) return -1;
+
+	return convertFragment(table, view->pointTotal, view->forwardOffset, view->pointStartIndex, view->pointCount,
+						   view->distances, x, y, valid);
+}/*sf40ViewToCartesian*/
+
+
+/*! \brief Convert a packet from getStream to x/y
+ *
+ *  \param table angle table, rebuild when it doesn't belong to the revolution of the packet
+ *
+ *  \param packet packet from getStream
+ *
+ *  \retval Amount of valid points
+ *  \retval -1 : the packet holds more than SF40_MAX_STREAM_POINTS points, or doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS
+ *
+ *  \details Same as sf40ViewToCartesian.
+ */
+int32_t sf40PacketToCartesian(sf40AngleTable_t* table, const streamOutput_t* packet, float* x, float* y, uint8_t* valid){
+	if(packet->pointCount > SF40_MAX_STREAM_POINTS) return -1;
+
+	#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	const uint8_t* raw = (const uint8_t*)packet->pointDistances;
+	#else
+	uint8_t raw[SF40_MAX_STREAM_POINTS * 2];
+	for(uint16_t i = 0; i < packet->pointCount; i++){
+		raw[i*2]     = (uint8_t)packet->pointDistances[i];
+		raw[(i*2)+1] = (uint8_t)((uint16_t)packet->pointDistances[i] >> 8);
+	}
+	#endif
+
+	return convertFragment(table, packet->pointTotal, packet->forwardOffset, packet->pointStartIndex, packet->pointCount,
+						   raw, x, y, valid);
+}/*sf40PacketToCartesian*/
@@ -0,0 +1,26 @@
+#ifndef _SF40_CARTESIAN_H_
+#define _SF40_CARTESIAN_H_
+
+    #include <stdint.h>
+    #include <stdbool.h>
+
+    #include "lightwareSF40.h"
+    #include "lightwareSF40Scan.h"
+    #include "lightwareSF40Decode.h"
+
+    // cos and sin of the angle of every point in a revolution, rebuilt only when pointTotal or forwardOffset changes
+    typedef struct{
+        bool        ready;                          // true when the tables below belong to pointTotal and forwardOffset
+        uint16_t    pointTotal;                     // Number of points in the revolution the tables were build for
+        int16_t     forwardOffset;                  // Forward offset [deg] the tables were build for
+        float       cosTable[SF40_MAX_SCAN_POINTS]; // cos of the angle of each point
+        float       sinTable[SF40_MAX_SCAN_POINTS]; // sin of the angle of each point
+    }sf40AngleTable_t;
+
+    void sf40AngleTableInit(sf40AngleTable_t* table);
+    int sf40PrepareAngles(sf40AngleTable_t* table, uint16_t pointTotal, int16_t forwardOffset);
+    int32_t sf40ScanToCartesian(sf40AngleTable_t* table, const sf40Scan_t* scan, float* x, float* y, uint8_t* valid);
+    int32_t sf40ViewToCartesian(sf40AngleTable_t* table, const streamView_t* view, float* x, float* y, uint8_t* valid);
+    int32_t sf40PacketToCartesian(sf40AngleTable_t* table, const streamOutput_t* packet, float* x, float* y, uint8_t* valid);
+
+#endif
@@ -0,0 +1,253 @@
+/*!
+ *  \file    lightwareSF40Decode.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Conversion of the raw distances in a stream packet to meters or fixed point,
+ *           together with a mask of which points hold a valid distance
+ */
+
+#include "lightwareSF40Decode.h"
+#include "lightwareSF40Simd.h"
+
+typedef uint16_t (*metersKernel_t)(const uint8_t* raw, uint16_t count, float* meters, uint8_t* valid);
+typedef uint16_t (*fixedKernel_t)(const uint8_t* raw, uint16_t count, int16_t scale, int32_t* fixed, uint8_t* valid);
+
+
+/*! \brief Convert distances to meters one point at a time
+ *
+ *  \details Works on any cpu, the distances are assembled from their two bytes.
+ */
+static uint16_t metersScalar(const uint8_t* raw, uint16_t count, float* meters, uint8_t* valid){
+	uint16_t valids = 0;
+	for(uint16_t i = 0; i < count; i++){
+		int16_t distance = (int16_t)(raw[(i*2)+1]<<8 | raw[i*2]);
+		meters[i] = distance * 0.01f;
+
+		valids += (distance >= 0);
+		sf40SetValid(valid, i, distance >= 0);
+	}
+	return valids;
+}/*metersScalar*/
+
+
+/*! \brief Convert distances to fixed point one point at a time
+ */
+static uint16_t fixedScalar(const uint8_t* raw, uint16_t count, int16_t scale, int32_t* fixed, uint8_t* valid){
+	uint16_t valids = 0;
+	for(uint16_t i = 0; i < count; i++){
+		int16_t distance = (int16_t)(raw[(i*2)+1]<<8 | raw[i*2]);
+		fixed[i] = (int32_t)distance * scale;
+
+		valids += (distance >= 0);
+		sf40SetValid(valid, i, distance >= 0);
+	}
+	return valids;
+}/*fixedScalar*/
+
+
+#if defined(SF40_SIMD_X86)
+/*! \brief Convert distances to meters, 8 points at a time
+ */
+__attribute__((target("sse2")))
+static uint16_t metersSse2(const uint8_t* raw, uint16_t count, float* meters, uint8_t* valid){
+	const __m128 centimeter = _mm_set1_ps(0.01f);
+	uint16_t valids = 0;
+	uint16_t i = 0;
+
+	for(; i + 8 <= count; i += 8){
+		__m128i distances = _mm_loadu_si128((const __m128i*)&raw[i * 2]);
+		__m128i low  = _mm_srai_epi32(_mm_unpacklo_epi16(distances, distances), 16);
+		__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(distances, distances), 16);
+		_mm_storeu_ps(&meters[i],     _mm_mul_ps(_mm_cvtepi32_ps(low), centimeter));
+		_mm_storeu_ps(&meters[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(high), centimeter));
+
+		uint8_t mask = sf40ValidSse2(distances);
+		valids += __builtin_popcount(mask);
+		if(valid != NULL) valid[i / 8] = mask;
+	}
+	return valids + metersScalar(&raw[i * 2], count - i, &meters[i], valid != NULL ? &valid[i / 8] : NULL);
+}/*metersSse2*/
+
+
+/*! \brief Convert distances to fixed point, 8 points at a time
+ *
+ *  \details The low and high halves of the 16 bit products are interleaved into 32 bit results.
+ */
+__attribute__((target("sse2")))
+static uint16_t fixedSse2(const uint8_t* raw, uint16_t count, int16_t scale, int32_t* fixed, uint8_t* valid){
+	const __m128i factor = _mm_set1_epi16(scale);
+	uint16_t valids = 0;
+	uint16_t i = 0;
+
+	for(; i + 8 <= count; i += 8){
+		__m128i distances = _mm_loadu_si128((const __m128i*)&raw[i * 2]);
+		__m128i low  = _mm_mullo_epi16(distances, factor);
+		__m128i high = _mm_mulhi_epi16(distances, factor);
+		_mm_storeu_si128((__m128i*)&fixed[i],     _mm_unpacklo_epi16(low, high));
+		_mm_storeu_si128((__m128i*)&fixed[i + 4], _mm_unpackhi_epi16(low, high));
+
+		uint8_t mask = sf40ValidSse2(distances);
+		valids += __builtin_popcount(mask);
+		if(valid != NULL) valid[i / 8] = mask;
+	}
+	return valids + fixedScalar(&raw[i * 2], count - i, scale, &fixed[i], valid != NULL ? &valid[i / 8] : NULL);
+}/*fixedSse2*/
+
+
+/*! \brief Convert distances to meters, 16 points at a time
+ */
+__attribute__((target("avx2")))
+static uint16_t metersAvx2(const uint8_t* raw, uint16_t count, float* meters, uint8_t* valid){
+	const __m256 centimeter = _mm256_set1_ps(0.01f);
+	uint16_t valids = 0;
+	uint16_t i = 0;
+
+	for(; i + 16 <= count; i += 16){
+		__m256i distances = _mm256_loadu_si256((const __m256i*)&raw[i * 2]);
+		__m256i low  = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(distances));
+		__m256i high = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(distances, 1));
+		_mm256_storeu_ps(&meters[i],     _mm256_mul_ps(_mm256_cvtepi32_ps(low), centimeter));
+		_mm256_storeu_ps(&meters[i + 8], _mm256_mul_ps(_mm256_cvtepi32_ps(high), centimeter));
+
+		uint16_t mask = sf40ValidAvx2(distances);
+		valids += __builtin_popcount(mask);
+		if(valid != NULL){
+			valid[i / 8]     = (uint8_t)mask;
+			valid[i / 8 + 1] = (uint8_t)(mask >> 8);
+		}
+	}
+	return valids + metersSse2(&raw[i * 2], count - i, &meters[i], valid != NULL ? &valid[i / 8] : NULL);
+}/*metersAvx2*/
+
+
+/*! \brief Convert distances to fixed point, 16 points at a time
+ */
+__attribute__((target("avx2")))
+static uint16_t fixedAvx2(const uint8_t* raw, uint16_t count, int16_t scale, int32_t* fixed, uint8_t* valid){
+	const __m256i factor = _mm256_set1_epi32(scale);
+	uint16_t valids = 0;
+	uint16_t i = 0;
+
+	for(; i + 16 <= count; i += 16){
+		__m256i distances = _mm256_loadu_si256((const __m256i*)&raw[i * 2]);
+		__m256i low  = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(distances));
+		__m256i high = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(distances, 1));
+		_mm256_storeu_si256((__m256i*)&fixed[i],     _mm256_mullo_epi32(low, factor));
+		_mm256_storeu_si256((__m256i*)&fixed[i + 8], _mm256_mullo_epi32(high, factor));
+
+		uint16_t mask = sf40ValidAvx2(distances);
+		valids += __builtin_popcount(mask);
+		if(valid != NULL){
+			valid[i / 8]     = (uint8_t)mask;
+			valid[i / 8 + 1] = (uint8_t)(mask >> 8);
+		}
+	}
+	return valids + fixedSse2(&raw[i * 2], count - i, scale, &fixed[i], valid != NULL ? &valid[i / 8] : NULL);
+}/*fixedAvx2*/
+#endif
+
+
+#if defined(SF40_SIMD_NEON)
+/*! \brief Convert distances to meters, 8 points at a time
+ */
+static uint16_t metersNeon(const uint8_t* raw, uint16_t count, float* meters, uint8_t* valid){
+	uint16_t valids = 0;
+	uint16_t i = 0;
+
+	for(; i + 8 <= count; i += 8){
+		int16x8_t distances = vreinterpretq_s16_u8(vld1q_u8(&raw[i * 2]));
+		vst1q_f32(&meters[i],     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(distances))), 0.01f));
+		vst1q_f32(&meters[i + 4], vmulq_n_f32(vcvtq_f32_s32(vmovl_high_s16(distances)), 0.01f));
+
+		uint8_t mask = sf40ValidNeon(distances);
+		valids += __builtin_popcount(mask);
+		if(valid != NULL) valid[i / 8] = mask;
+	}
+	return valids + metersScalar(&raw[i * 2], count - i, &meters[i], valid != NULL ? &valid[i / 8] : NULL);
+}/*metersNeon*/
+
+
+/*! \brief Convert distances to fixed point, 8 points at a time
+ */
+static uint16_t fixedNeon(const uint8_t* raw, uint16_t count, int16_t scale, int32_t* fixed, uint8_t* valid){
+	uint16_t valids = 0;
+	uint16_t i = 0;
+
+	for(; i + 8 <= count; i += 8){
+		int16x8_t distances = vreinterpretq_s16_u8(vld1q_u8(&raw[i * 2]));
+		vst1q_s32(&fixed[i],     vmull_n_s16(vget_low_s16(distances), scale));
+		vst1q_s32(&fixed[i + 4], vmull_high_n_s16(distances, scale));
+
+		uint8_t mask = sf40ValidNeon(distances);
+		valids += __builtin_popcount(mask);
+		if(valid != NULL) valid[i / 8] = mask;
+	}
+	return valids + fixedScalar(&raw[i * 2], count - i, scale, &fixed[i], valid != NULL ? &valid[i / 8] : NULL);
+}/*fixedNeon*/
+#endif
+
+
+// Kernels of every instruction set, SF40_KERNEL picks the one the cpu supports
+static const metersKernel_t metersKernels[SF40_SIMD_LEVELS] = {
+	[SF40_SIMD_SCALAR] = metersScalar,
+	#if defined(SF40_SIMD_X86)
+	[SF40_SIMD_SSE2]   = metersSse2,
+	[SF40_SIMD_AVX2]   = metersAvx2,
+	#elif defined(SF40_SIMD_NEON)
+	[SF40_SIMD_NEON]   = metersNeon,
+	#endif
+};
+
+static const fixedKernel_t fixedKernels[SF40_SIMD_LEVELS] = {
+	[SF40_SIMD_SCALAR] = fixedScalar,
+	#if defined(SF40_SIMD_X86)
+	[SF40_SIMD_SSE2]   = fixedSse2,
+	[SF40_SIMD_AVX2]   = fixedAvx2,
+	#elif defined(SF40_SIMD_NEON)
+	[SF40_SIMD_NEON]   = fixedNeon,
+	#endif
+};
+
+
+/*! \brief Convert the distances of a stream packet to meters
+ *
+ *  \param raw distances as they are in the packet: little endian 16 bit values in cm
+ *
+ *  \param count number of distances
+ *
+ *  \param meters location where the distances in meters need to be saved, must hold count floats
+ *
+ *  \param valid location for the validity mask, must hold SF40_VALID_BYTES(count) bytes, can be NULL
+ *
+ *  \return Amount of valid points
+ *
+ *  \details A point is valid when its distance isn't negative. Bit i%8 of valid[i/8] is set for valid point i.
+ *           Conversion and mask are made in a single pass, with AVX2, SSE2 or NEON when the cpu has it.
+ *           pointDistances of a streamOutput_t can be passed as raw on little endian hosts.
+ */
+uint16_t sf40DistancesToMeters(const uint8_t* raw, uint16_t count, float* meters, uint8_t* valid){
+	return SF40_KERNEL(metersKernels)(raw, count, meters, valid);
+}/*sf40DistancesToMeters*/
+
+
+/*! \brief Convert the distances of a stream packet to fixed point
+ *
+ *  \param raw distances as they are in the packet: little endian 16 bit values in cm
+ *
+ *  \param count number of distances
+ *
+ *  \param scale every distance in cm is multiplied by scale, for example 10 gives mm
+ *
+ *  \param fixed location where the scaled distances need to be saved, must hold count values
+ *
+ *  \param valid location for the validity mask, must hold SF40_VALID_BYTES(count) bytes, can be NULL
+ *
+ *  \return Amount of valid points
+ *
+ *  \details Same mask and cpu selection as sf40DistancesToMeters.
+ */
+uint16_t sf40DistancesToFixed(const uint8_t* raw, uint16_t count, int16_t scale, int32_t* fixed, uint8_t* valid){
+	return SF40_KERNEL(fixedKernels)(raw, count, scale, fixed, valid);
+}/*sf40DistancesToFixed*/
@@ -0,0 +1,14 @@
+#ifndef _SF40_DECODE_H_
+#define _SF40_DECODE_H_
+
+    #include <stdint.h>
+    #include <stddef.h>
+
+    #define SF40_VALID_BYTES(count) (((count) + 7) / 8)     // Bytes needed for the validity mask of count points
+
+    // Convert raw distances [cm] to meters, returns the number of valid points
+    uint16_t sf40DistancesToMeters(const uint8_t* raw, uint16_t count, float* meters, uint8_t* valid);
+    // Convert raw distances [cm] to distance * scale, returns the number of valid points
+    uint16_t sf40DistancesToFixed(const uint8_t* raw, uint16_t count, int16_t scale, int32_t* fixed, uint8_t* valid);
+
+#endif
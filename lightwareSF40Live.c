@@ -0,0 +1,159 @@
+/*!
+ *  \file    lightwareSF40Live.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Sliding 360 degree view: every stream packet overwrites its own points right away,
+ *           readers take a consistent snapshot through a sequence lock
+ */
+
+#include "lightwareSF40Live.h"
+#include "lightwareSF40Simd.h"
+#include <string.h>
+#include <stdbool.h>
+
+
+/*! \brief Sector a point belongs to
+ *
+ *  \param pointTotal number of points in the revolution
+ *
+ *  \param index index of the point
+ *
+ *  \return sector from 0 up to SF40_LIVE_SECTORS, sector s holds the points from s * pointTotal / SF40_LIVE_SECTORS on
+ */
+uint16_t sf40LiveSector(uint16_t pointTotal, uint16_t index){
+	return (uint16_t)((uint32_t)index * SF40_LIVE_SECTORS / pointTotal);
+}/*sf40LiveSector*/
+
+
+/*! \brief Prepare a live scan for its first packet
+ *
+ *  \param live live scan that needs to be prepared
+ */
+void sf40LiveInit(sf40LiveScan_t* live){
+	atomic_init(&live->sequence, 0);
+	live->pointTotal = 0;
+	live->forwardOffset = 0;
+	memset(live->sectorTime, 0, sizeof(live->sectorTime));
+}/*sf40LiveInit*/
+
+
+/*! \brief Write the points of a packet over the older points at the same angles
+ *
+ *  \param distances distances of the packet, little endian bytes when raw is true, otherwise int16_t values
+ *
+ *  \retval  0 : the points have been written
+ *  \retval -1 : the packet doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS, it is ignored
+ *
+ *  \details The sequence is odd while writing, so readers know to try again. When pointTotal changes
+ *           every sector is marked as never written.
+ */
+static int addFragment(sf40LiveScan_t* live, uint16_t pointTotal, int16_t forwardOffset, uint16_t pointStartIndex,
+					   uint16_t pointCount, const void* distances, bool raw){
+	if(pointTotal == 0 || pointTotal > SF40_MAX_SCAN_POINTS) return -1;
+	if((uint32_t)pointStartIndex + pointCount > pointTotal) return -1;
+	if(pointCount == 0) return 0;
+
+	uint64_t now = sf40MonotonicTime();
+	unsigned int sequence = atomic_load_explicit(&live->sequence, memory_order_relaxed);
+	atomic_store_explicit(&live->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	if(pointTotal != live->pointTotal){
+		live->pointTotal = pointTotal;
+		memset(live->sectorTime, 0, sizeof(live->sectorTime));
+	}
+	live->forwardOffset = forwardOffset;
+
+	#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(&live->distances[pointStartIndex], distances, pointCount * sizeof(int16_t));
+	#else
+	if(raw){
+		const uint8_t* bytes = distances;
+		for(uint16_t i = 0; i < pointCount; i++){
+			live->distances[pointStartIndex + i] = (int16_t)(bytes[(i*2)+1]<<8 | bytes[i*2]);
+		}
+	}
+	else memcpy(&live->distances[pointStartIndex], distances, pointCount * sizeof(int16_t));
+	#endif
+	(void)raw;
+
+	uint16_t last = sf40LiveSector(pointTotal, pointStartIndex + pointCount - 1);
+	for(uint16_t sector = sf40LiveSector(pointTotal, pointStartIndex); sector <= last; sector++){
+		live->sectorTime[sector] = now;
+	}
+
+	atomic_store_explicit(&live->sequence, sequence + 2, memory_order_release);
+	return 0;
+}/*addFragment*/
+
+
+/*! \brief Write a packet from acquireStream into the live scan
+ *
+ *  \param live live scan that is updated
+ *
+ *  \param view packet from acquireStream, it can be released right after this call
+ *
+ *  \retval  0 : the points have been written
+ *  \retval -1 : the packet doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS, it is ignored
+ *
+ *  \details Only one thread may write into a live scan, any thread can take a snapshot at the same time.
+ */
+int sf40LiveAddView(sf40LiveScan_t* live, const streamView_t* view){
+	return addFragment(live, view->pointTotal, view->forwardOffset, view->pointStartIndex, view->pointCount,
+					   view->distances, true);
+}/*sf40LiveAddView*/
+
+
+/*! \brief Write a packet from getStream into the live scan
+ *
+ *  \param live live scan that is updated
+ *
+ *  \param packet packet from getStream
+ *
+ *  \retval  0 : the points have been written
+ *  \retval -1 : the packet doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS, it is ignored
+ *
+ *  \details Same as sf40LiveAddView.
+ */
+int sf40LiveAddPacket(sf40LiveScan_t* live, const streamOutput_t* packet){
+	return addFragment(live, packet->pointTotal, packet->forwardOffset, packet->pointStartIndex, packet->pointCount,
+					   packet->pointDistances, false);
+}/*sf40LiveAddPacket*/
+
+
+/*! \brief Take a consistent copy of a live scan
+ *
+ *  \param live live scan, can be written by another thread at the same time
+ *
+ *  \param snapshot location where the copy needs to be saved
+ *
+ *  \retval  0 : the snapshot holds the newest distance of every point
+ *  \retval -1 : no packet has been written yet
+ *
+ *  \details The copy is taken again when a packet was written during it, it never waits on the writer.
+ *           The age of sector s is taken - sectorTime[s], sf40LiveSector gives the sector of a point.
+ */
+int sf40LiveSnapshot(const sf40LiveScan_t* live, sf40LiveSnapshot_t* snapshot){
+	unsigned int before, after = 0;
+
+	do{
+		before = atomic_load_explicit(&live->sequence, memory_order_acquire);
+		if(before & 1) continue;
+
+		uint16_t pointTotal = live->pointTotal;
+		if(pointTotal > SF40_MAX_SCAN_POINTS) pointTotal = SF40_MAX_SCAN_POINTS;
+
+		snapshot->pointTotal = pointTotal;
+		snapshot->forwardOffset = live->forwardOffset;
+		memcpy(snapshot->sectorTime, live->sectorTime, sizeof(snapshot->sectorTime));
+		memcpy(snapshot->distances, live->distances, pointTotal * sizeof(int16_t));
+
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&live->sequence, memory_order_relaxed);
+	}while((before & 1) || before != after);
+
+	snapshot->taken = sf40MonotonicTime();
+	return snapshot->pointTotal ? 0 : -1;
+}/*sf40LiveSnapshot*/
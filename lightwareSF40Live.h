@@ -0,0 +1,36 @@
+#ifndef _SF40_LIVE_H_
+#define _SF40_LIVE_H_
+
+    #include <stdint.h>
+    #include <stdatomic.h>
+
+    #include "lightwareSF40.h"
+    #include "lightwareSF40Scan.h"
+
+    #define SF40_LIVE_SECTORS 64            // Number of sectors a revolution is split in for the age stamps, change it here so the library is built with the same value
+
+    // Newest distance for every angle, overwritten packet by packet; one thread writes, any thread can take a snapshot
+    typedef struct{
+        atomic_uint sequence;                               // Odd while a packet is being written
+        uint16_t    pointTotal;                             // Number of points in the revolution, 0 until the first packet
+        int16_t     forwardOffset;                          // Orientation offset of the last packet
+        uint64_t    sectorTime[SF40_LIVE_SECTORS];          // Monotonic time [us] each sector was last written, 0 when never
+        int16_t     distances[SF40_MAX_SCAN_POINTS];        // Newest distance [cm] of every point
+    }sf40LiveScan_t;
+
+    // Consistent copy of a live scan
+    typedef struct{
+        uint64_t    taken;                                  // Monotonic time [us] the snapshot was taken
+        uint16_t    pointTotal;                             // Number of points in the revolution, 0 when nothing was received yet
+        int16_t     forwardOffset;                          // Orientation offset of the last packet
+        uint64_t    sectorTime[SF40_LIVE_SECTORS];          // Monotonic time [us] each sector was last written, 0 when never
+        int16_t     distances[SF40_MAX_SCAN_POINTS];        // Newest distance [cm] of every point
+    }sf40LiveSnapshot_t;
+
+    void sf40LiveInit(sf40LiveScan_t* live);
+    int sf40LiveAddView(sf40LiveScan_t* live, const streamView_t* view);
+    int sf40LiveAddPacket(sf40LiveScan_t* live, const streamOutput_t* packet);
+    int sf40LiveSnapshot(const sf40LiveScan_t* live, sf40LiveSnapshot_t* snapshot);
+    uint16_t sf40LiveSector(uint16_t pointTotal, uint16_t index);
+
+#endif
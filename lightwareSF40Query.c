@@ -0,0 +1,461 @@
+/*!
+ *  \file    lightwareSF40Query.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Answers LIDAR_DISTANCE requests from an assembled scan, without asking the lidar
+ */
+
+#include "lightwareSF40Query.h"
+#include "lightwareSF40Simd.h"
+
+#define QUERY_BATCH  64                     // Views whose ranges are worked out together
+#define QUERY_BLOCK  128                    // Points summarised together in the pass over the scan, a multiple of 16
+#define QUERY_SPAN   (4 * QUERY_BLOCK)      // Points a view needs before it is put together from the summary
+#define SCAN_BLOCKS  ((SF40_MAX_SCAN_POINTS + QUERY_BLOCK - 1) / QUERY_BLOCK)
+
+// What has been found in a window so far
+typedef struct{
+	int32_t  sum;				// Sum of the distances of the points that count
+	uint16_t count;				// Number of points that count
+	int16_t  closest;			// Closest distance, INT16_MAX when no point counts
+	int16_t  furthest;			// Furthest distance, -1 when no point counts
+	uint16_t closestIndex;		// Index of the first point at the closest distance
+}windowStats_t;
+
+// Points a view looks at, points in a row from first on, wrapping past the end of the scan
+typedef struct{
+	uint16_t first;
+	uint16_t points;
+	int16_t  minimum;			// Closest distance that counts
+}viewRange_t;
+
+typedef void (*windowKernel_t)(const int16_t* distances, const uint8_t* coverage, uint16_t start, uint16_t end,
+							   int16_t minimum, windowStats_t* stats);
+
+
+/*! \brief Take the points from start up to end into the window one point at a time
+ *
+ *  \details A point counts when it has been received and its distance is at least minimum.
+ */
+static void windowScalar(const int16_t* distances, const uint8_t* coverage, uint16_t start, uint16_t end,
+						 int16_t minimum, windowStats_t* stats){
+	for(uint16_t i = start; i < end; i++){
+		int16_t distance = distances[i];
+		if(!((coverage[i >> 3] >> (i & 7)) & 1) || distance < minimum) continue;
+
+		stats->sum += distance;
+		stats->count++;
+		if(distance < stats->closest){
+			stats->closest = distance;
+			stats->closestIndex = i;
+		}
+		if(distance > stats->furthest) stats->furthest = distance;
+	}
+}/*windowScalar*/
+
+
+/*! \brief Add the closest distance of every lane to the window
+ *
+ *  \param closest closest distance found by each lane
+ *
+ *  \param index index of the first point at that distance in each lane
+ *
+ *  \details Of equal distances the lowest index is taken, so the result doesn't depend on the lane width.
+ */
+static void mergeLanes(const int16_t* closest, const int16_t* index, int lanes, windowStats_t* stats){
+	int16_t best = stats->closest;
+	uint16_t bestIndex = stats->closestIndex;
+	int16_t found = INT16_MAX;
+	uint16_t foundIndex = UINT16_MAX;
+
+	for(int lane = 0; lane < lanes; lane++){
+		if(closest[lane] < found || (closest[lane] == found && (uint16_t)index[lane] < foundIndex)){
+			found = closest[lane];
+			foundIndex = (uint16_t)index[lane];
+		}
+	}
+	if(found < best){
+		best = found;
+		bestIndex = foundIndex;
+	}
+	stats->closest = best;
+	stats->closestIndex = bestIndex;
+}/*mergeLanes*/
+
+
+#if defined(SF40_SIMD_X86)
+/*! \brief Take the points into the window 8 at a time
+ *
+ *  \details start must be a multiple of 8, so every 8 points have their own coverage byte.
+ *           Points that don't count are replaced by INT16_MAX for the closest and by -1 for the furthest distance.
+ */
+__attribute__((target("sse2")))
+static void windowSse2(const int16_t* distances, const uint8_t* coverage, uint16_t start, uint16_t end,
+					   int16_t minimum, windowStats_t* stats){
+	const __m128i bits   = _mm_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128);
+	const __m128i limit  = _mm_set1_epi16(minimum - 1);
+	const __m128i ones   = _mm_set1_epi16(1);
+	const __m128i far    = _mm_set1_epi16(INT16_MAX);
+	const __m128i lanes  = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+	__m128i sum      = _mm_setzero_si128();
+	__m128i closest  = far;
+	__m128i index    = _mm_setzero_si128();
+	__m128i furthest = _mm_set1_epi16(-1);
+	uint32_t count = 0;
+	uint16_t i = start;
+
+	for(; i + 8 <= end; i += 8){
+		__m128i distance = _mm_loadu_si128((const __m128i*)&distances[i]);
+		__m128i covered  = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(coverage[i >> 3]), bits), bits);
+		__m128i counts   = _mm_and_si128(covered, _mm_cmpgt_epi16(distance, limit));
+
+		__m128i kept = _mm_and_si128(counts, distance);
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(kept, ones));
+		count += __builtin_popcount(_mm_movemask_epi8(counts)) / 2;
+
+		__m128i near   = _mm_or_si128(kept, _mm_andnot_si128(counts, far));
+		__m128i closer = _mm_cmpgt_epi16(closest, near);
+		closest  = _mm_min_epi16(closest, near);
+		index    = _mm_or_si128(_mm_and_si128(closer, _mm_add_epi16(lanes, _mm_set1_epi16(i))), _mm_andnot_si128(closer, index));
+		furthest = _mm_max_epi16(furthest, _mm_or_si128(kept, _mm_andnot_si128(counts, _mm_set1_epi16(-1))));
+	}
+
+	int32_t sums[4];
+	int16_t closests[8], indexes[8], furthests[8];
+	_mm_storeu_si128((__m128i*)sums, sum);
+	_mm_storeu_si128((__m128i*)closests, closest);
+	_mm_storeu_si128((__m128i*)indexes, index);
+	_mm_storeu_si128((__m128i*)furthests, furthest);
+
+	stats->sum += sums[0] + sums[1] + sums[2] + sums[3];
+	stats->count += count;
+	for(int lane = 0; lane < 8; lane++){
+		if(furthests[lane] > stats->furthest) stats->furthest = furthests[lane];
+	}
+	mergeLanes(closests, indexes, 8, stats);
+
+	windowScalar(distances, coverage, i, end, minimum, stats);
+}/*windowSse2*/
+
+
+/*! \brief Take the points into the window 16 at a time
+ *
+ *  \details start must be a multiple of 8, the 16 points of each step use two coverage bytes.
+ */
+__attribute__((target("avx2")))
+static void windowAvx2(const int16_t* distances, const uint8_t* coverage, uint16_t start, uint16_t end,
+					   int16_t minimum, windowStats_t* stats){
+	const __m256i bits   = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128);
+	const __m256i limit  = _mm256_set1_epi16(minimum - 1);
+	const __m256i ones   = _mm256_set1_epi16(1);
+	const __m256i far    = _mm256_set1_epi16(INT16_MAX);
+	const __m256i lanes  = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	__m256i sum      = _mm256_setzero_si256();
+	__m256i closest  = far;
+	__m256i index    = _mm256_setzero_si256();
+	__m256i furthest = _mm256_set1_epi16(-1);
+	uint32_t count = 0;
+	uint16_t i = start;
+
+	for(; i + 16 <= end; i += 16){
+		__m256i distance = _mm256_loadu_si256((const __m256i*)&distances[i]);
+		__m256i spread   = _mm256_setr_m128i(_mm_set1_epi16(coverage[i >> 3]), _mm_set1_epi16(coverage[(i >> 3) + 1]));
+		__m256i covered  = _mm256_cmpeq_epi16(_mm256_and_si256(spread, bits), bits);
+		__m256i counts   = _mm256_and_si256(covered, _mm256_cmpgt_epi16(distance, limit));
+
+		__m256i kept = _mm256_and_si256(counts, distance);
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(kept, ones));
+		count += __builtin_popcount(_mm256_movemask_epi8(counts)) / 2;
+
+		__m256i near   = _mm256_or_si256(kept, _mm256_andnot_si256(counts, far));
+		__m256i closer = _mm256_cmpgt_epi16(closest, near);
+		closest  = _mm256_min_epi16(closest, near);
+		index    = _mm256_blendv_epi8(index, _mm256_add_epi16(lanes, _mm256_set1_epi16(i)), closer);
+		furthest = _mm256_max_epi16(furthest, _mm256_or_si256(kept, _mm256_andnot_si256(counts, _mm256_set1_epi16(-1))));
+	}
+
+	int32_t sums[8];
+	int16_t closests[16], indexes[16], furthests[16];
+	_mm256_storeu_si256((__m256i*)sums, sum);
+	_mm256_storeu_si256((__m256i*)closests, closest);
+	_mm256_storeu_si256((__m256i*)indexes, index);
+	_mm256_storeu_si256((__m256i*)furthests, furthest);
+
+	for(int lane = 0; lane < 8; lane++) stats->sum += sums[lane];
+	stats->count += count;
+	for(int lane = 0; lane < 16; lane++){
+		if(furthests[lane] > stats->furthest) stats->furthest = furthests[lane];
+	}
+	mergeLanes(closests, indexes, 16, stats);
+
+	windowSse2(distances, coverage, i, end, minimum, stats);
+}/*windowAvx2*/
+#endif
+
+
+#if defined(SF40_SIMD_NEON)
+/*! \brief Take the points into the window 8 at a time
+ *
+ *  \details start must be a multiple of 8, so every 8 points have their own coverage byte.
+ */
+static void windowNeon(const int16_t* distances, const uint8_t* coverage, uint16_t start, uint16_t end,
+					   int16_t minimum, windowStats_t* stats){
+	const int16x8_t bits  = {1, 2, 4, 8, 16, 32, 64, 128};
+	const int16x8_t lanes = {0, 1, 2, 3, 4, 5, 6, 7};
+	const int16x8_t far   = vdupq_n_s16(INT16_MAX);
+	int32x4_t sum      = vdupq_n_s32(0);
+	int16x8_t closest  = far;
+	int16x8_t index    = vdupq_n_s16(0);
+	int16x8_t furthest = vdupq_n_s16(-1);
+	uint32_t count = 0;
+	uint16_t i = start;
+
+	for(; i + 8 <= end; i += 8){
+		int16x8_t distance = vld1q_s16(&distances[i]);
+		uint16x8_t counts  = vandq_u16(vtstq_s16(vdupq_n_s16(coverage[i >> 3]), bits), vcgeq_s16(distance, vdupq_n_s16(minimum)));
+
+		int16x8_t kept = vandq_s16(vreinterpretq_s16_u16(counts), distance);
+		sum = vpadalq_s16(sum, kept);
+		count += vaddvq_u16(vshrq_n_u16(counts, 15));
+
+		int16x8_t near    = vbslq_s16(counts, distance, far);
+		uint16x8_t closer = vcgtq_s16(closest, near);
+		closest  = vminq_s16(closest, near);
+		index    = vbslq_s16(closer, vaddq_s16(lanes, vdupq_n_s16(i)), index);
+		furthest = vmaxq_s16(furthest, vbslq_s16(counts, distance, vdupq_n_s16(-1)));
+	}
+
+	int16_t closests[8], indexes[8];
+	vst1q_s16(closests, closest);
+	vst1q_s16(indexes, index);
+
+	stats->sum += vaddvq_s32(sum);
+	stats->count += count;
+	int16_t lanesFurthest = vmaxvq_s16(furthest);
+	if(lanesFurthest > stats->furthest) stats->furthest = lanesFurthest;
+	mergeLanes(closests, indexes, 8, stats);
+
+	windowScalar(distances, coverage, i, end, minimum, stats);
+}/*windowNeon*/
+#endif
+
+
+// Kernels of every instruction set, SF40_KERNEL picks the one the cpu supports
+static const windowKernel_t windowKernels[SF40_SIMD_LEVELS] = {
+	[SF40_SIMD_SCALAR] = windowScalar,
+	#if defined(SF40_SIMD_X86)
+	[SF40_SIMD_SSE2]   = windowSse2,
+	[SF40_SIMD_AVX2]   = windowAvx2,
+	#elif defined(SF40_SIMD_NEON)
+	[SF40_SIMD_NEON]   = windowNeon,
+	#endif
+};
+
+
+/*! \brief Take the points from start up to end into the window
+ *
+ *  \details The points up to the next multiple of 8 are taken one at a time, so the kernel starts on a coverage byte.
+ */
+static void addRange(const sf40Scan_t* scan, uint16_t start, uint16_t end, int16_t minimum, windowStats_t* stats){
+	uint16_t aligned = (start + 7) & ~7;
+	if(aligned > end) aligned = end;
+
+	windowScalar(scan->distances, scan->coverage, start, aligned, minimum, stats);
+	SF40_KERNEL(windowKernels)(scan->distances, scan->coverage, aligned, end, minimum, stats);
+}/*addRange*/
+
+
+/*! \brief Add what has been found in a part of the window to the window
+ *
+ *  \details part has to come after everything already in stats, so of equal closest distances the first is kept.
+ */
+static void mergeStats(windowStats_t* stats, const windowStats_t* part){
+	stats->sum   += part->sum;
+	stats->count += part->count;
+	if(part->closest < stats->closest){
+		stats->closest = part->closest;
+		stats->closestIndex = part->closestIndex;
+	}
+	if(part->furthest > stats->furthest) stats->furthest = part->furthest;
+}/*mergeStats*/
+
+
+/*! \brief Summarise every QUERY_BLOCK points of the scan in one pass, for one minimum distance
+ */
+static void summariseScan(const sf40Scan_t* scan, int16_t minimum, windowStats_t* blocks){
+	for(uint32_t start = 0, b = 0; start < scan->pointTotal; start += QUERY_BLOCK, b++){
+		uint32_t end = (scan->pointTotal - start > QUERY_BLOCK) ? start + QUERY_BLOCK : scan->pointTotal;
+		blocks[b] = (windowStats_t){ .sum = 0, .count = 0, .closest = INT16_MAX, .furthest = -1, .closestIndex = 0 };
+		addRange(scan, start, end, minimum, &blocks[b]);
+	}
+}/*summariseScan*/
+
+
+/*! \brief Take the points from start up to end into the window, using the block summaries when there are any
+ *
+ *  \details Only the points before the first and after the last whole block are looked at again.
+ */
+static void addSpan(const sf40Scan_t* scan, const windowStats_t* blocks, uint16_t start, uint16_t end, int16_t minimum,
+					windowStats_t* stats){
+	uint16_t firstBlock = (start + QUERY_BLOCK - 1) / QUERY_BLOCK;
+	uint16_t lastBlock  = end / QUERY_BLOCK;
+	if(blocks == NULL || firstBlock >= lastBlock){
+		addRange(scan, start, end, minimum, stats);
+		return;
+	}
+
+	addRange(scan, start, firstBlock * QUERY_BLOCK, minimum, stats);
+	for(uint16_t b = firstBlock; b < lastBlock; b++) mergeStats(stats, &blocks[b]);
+	addRange(scan, lastBlock * QUERY_BLOCK, end, minimum, stats);
+}/*addSpan*/
+
+
+/*! \brief Find the points a LIDAR_DISTANCE request looks at
+ *
+ *  \details The window spans width degrees centred on direction. Point i lies at i * 360 / pointTotal + forwardOffset degrees.
+ */
+static viewRange_t viewRange(const sf40Scan_t* scan, const writeDistance_t* settings){
+	int32_t total = scan->pointTotal;
+	int32_t first = 0;
+	int32_t points = total;
+
+	if(settings->width < 360){
+		double from = (settings->direction - settings->width / 2.0 - scan->forwardOffset) * total / 360.0;
+		double to   = (settings->direction + settings->width / 2.0 - scan->forwardOffset) * total / 360.0;
+		int32_t low  = (int32_t)from + (from > (int32_t)from);
+		int32_t high = (int32_t)to - (to < (int32_t)to);
+		first  = ((low % total) + total) % total;
+		points = high - low + 1;
+		if(points < 0) points = 0;
+		if(points > total) points = total;
+	}
+
+	return (viewRange_t){ .first = (uint16_t)first, .points = (uint16_t)points,
+						  .minimum = settings->minimumDistance > 0 ? settings->minimumDistance : 0 };
+}/*viewRange*/
+
+
+/*! \brief Answer a single LIDAR_DISTANCE request from a scan
+ *
+ *  \param blocks summaries of the scan for the minimum distance of the view, NULL to look at every point
+ *
+ *  \details A window that passes 0 degrees is split in two ranges, which are taken in the order of the window.
+ */
+static void scanWindow(const sf40Scan_t* scan, const viewRange_t* view, const windowStats_t* blocks, readDistance_t* result){
+	int32_t total = scan->pointTotal;
+	windowStats_t stats = { .sum = 0, .count = 0, .closest = INT16_MAX, .furthest = -1, .closestIndex = 0 };
+
+	if(view->first + view->points <= total){
+		addSpan(scan, blocks, view->first, view->first + view->points, view->minimum, &stats);
+	}
+	else{
+		addSpan(scan, blocks, view->first, total, view->minimum, &stats);
+		addSpan(scan, blocks, 0, view->first + view->points - total, view->minimum, &stats);
+	}
+
+	if(stats.count == 0){
+		result->averageDistance  = -1;
+		result->closestDistance  = -1;
+		result->furthestDistance = -1;
+		result->angle            = 0;
+		return;
+	}
+
+	int32_t angle = (int32_t)((int64_t)stats.closestIndex * 3600 / total) + scan->forwardOffset * 10;
+	result->averageDistance  = (int16_t)(stats.sum / stats.count);
+	result->closestDistance  = stats.closest;
+	result->furthestDistance = stats.furthest;
+	result->angle            = (int16_t)(((angle % 3600) + 3600) % 3600);
+}/*scanWindow*/
+
+
+/*! \brief Answer up to QUERY_BATCH requests together
+ *
+ *  \details The views are grouped by minimum distance. When the views of a group that span at least QUERY_SPAN points
+ *           look at more points together than the scan holds, the scan is summarised once for that group and
+ *           those views only look at the points at their edges again, the whole blocks in between come from the summary.
+ *           Otherwise looking at the points of each view is cheaper than the pass over the scan.
+ */
+static void scanBatch(const sf40Scan_t* scan, const writeDistance_t* settings, readDistance_t* results, uint16_t count){
+	viewRange_t views[QUERY_BATCH];
+	bool answered[QUERY_BATCH] = { false };
+	windowStats_t blocks[SCAN_BLOCKS];
+
+	for(uint16_t i = 0; i < count; i++) views[i] = viewRange(scan, &settings[i]);
+
+	for(uint16_t i = 0; i < count; i++){
+		if(answered[i]) continue;
+
+		uint32_t points = 0;
+		for(uint16_t j = i; j < count; j++){
+			if(!answered[j] && views[j].minimum == views[i].minimum && views[j].points >= QUERY_SPAN) points += views[j].points;
+		}
+
+		const windowStats_t* summary = NULL;
+		if(points >= scan->pointTotal){
+			summariseScan(scan, views[i].minimum, blocks);
+			summary = blocks;
+		}
+
+		for(uint16_t j = i; j < count; j++){
+			if(answered[j] || views[j].minimum != views[i].minimum) continue;
+			scanWindow(scan, &views[j], views[j].points >= QUERY_SPAN ? summary : NULL, &results[j]);
+			answered[j] = true;
+		}
+	}
+}/*scanBatch*/
+
+
+/*! \brief Compute the average, closest and furthest distance within angular views from a scan,
+ *         the same as getDistance without asking the lidar.
+ *
+ *  \param scan scan from sf40ScanLatest
+ *
+ *  \param distanceSettings direction and width [degrees] of every view and the minimum distance [cm] that counts
+ *
+ *  \param receivedDistances struct for every view where the distances should be saved
+ *
+ *  \param count number of views
+ *
+ *  \retval  0 : all views have been answered
+ *  \retval -1 : there is no scan
+ *
+ *  \details A point counts when it has been received in the scan and is at least minimumDistance away.
+ *           When no point in a view counts, its distances are -1. The angle of the closest point is in 10ths of a degree
+ *           from 0 to 3599, of equal distances the first point in the view is taken.
+ *           Views with the same minimum distance are answered together: when they cover the scan more than once,
+ *           it is summarised in blocks in a single pass and the views are put together from those blocks.
+ *           calculationTime is the time all views took together.
+ */
+int sf40ScanDistances(const sf40Scan_t* scan, const writeDistance_t* distanceSettings, readDistance_t* receivedDistances, uint16_t count){
+	if(scan == NULL || scan->pointTotal == 0) return -1;
+	uint64_t start = sf40MonotonicTime();
+
+	for(uint32_t i = 0; i < count; i += QUERY_BATCH){
+		uint16_t batch = (count - i > QUERY_BATCH) ? QUERY_BATCH : count - i;
+		scanBatch(scan, &distanceSettings[i], &receivedDistances[i], batch);
+	}
+
+	uint32_t elapsed = (uint32_t)(sf40MonotonicTime() - start);
+	for(uint16_t i = 0; i < count; i++) receivedDistances[i].calculationTime = elapsed;
+	return 0;
+}/*sf40ScanDistances*/
+
+
+/*! \brief Compute the average, closest and furthest distance within an angular view from a scan,
+ *         the same as getDistance without asking the lidar.
+ *
+ *  \param scan scan from sf40ScanLatest
+ *
+ *  \param distanceSettings struct with different lidar distance settings
+ *
+ *  \param receivedDistances struct where the distances should be saved
+ *
+ *  \retval  0 : the view has been answered
+ *  \retval -1 : there is no scan
+ */
+int sf40ScanDistance(const sf40Scan_t* scan, writeDistance_t distanceSettings, readDistance_t* receivedDistances){
+	return sf40ScanDistances(scan, &distanceSettings, receivedDistances, 1);
+}/*sf40ScanDistance*/
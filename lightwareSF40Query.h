@@ -0,0 +1,12 @@
+#ifndef _SF40_QUERY_H_
+#define _SF40_QUERY_H_
+
+    #include <stdint.h>
+
+    #include "lightwareSF40.h"
+    #include "lightwareSF40Scan.h"
+
+    int sf40ScanDistance(const sf40Scan_t* scan, writeDistance_t distanceSettings, readDistance_t* receivedDistances);
+    int sf40ScanDistances(const sf40Scan_t* scan, const writeDistance_t* distanceSettings, readDistance_t* receivedDistances, uint16_t count);
+
+#endif
@@ -0,0 +1,172 @@
+/*!
+ *  \file    lightwareSF40Scan.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Assembles the stream packets of the lidar into complete 360 degree scans
+ */
+
+#include "lightwareSF40Scan.h"
+#include <string.h>
+
+
+/*! \brief Prepare an assembler for its first packet
+ *
+ *  \param assembler assembler that needs to be prepared
+ */
+void sf40ScanInit(sf40ScanAssembler_t* assembler){
+	memset(assembler, 0, sizeof(sf40ScanAssembler_t));
+	assembler->building = &assembler->scans[0];
+	assembler->finished = NULL;
+}/*sf40ScanInit*/
+
+
+/*! \brief Hand the scan that is being build to the consumer and start on the other buffer
+ */
+static void finishScan(sf40ScanAssembler_t* assembler){
+	sf40Scan_t* done = assembler->building;
+	done->lostPoints = done->pointTotal - done->pointsReceived;
+	assembler->lastRevolution = done->revolutionIndex;
+	assembler->finishedOnce = true;
+
+	assembler->building = (done == &assembler->scans[0]) ? &assembler->scans[1] : &assembler->scans[0];
+	assembler->finished = done;
+	assembler->started = false;
+}/*finishScan*/
+
+
+/*! \brief Mark the points from start up to end as received in the coverage of a scan
+ */
+static void markCoverage(sf40Scan_t* scan, uint16_t start, uint16_t end){
+	while(start < end && (start & 7)){
+		scan->coverage[start >> 3] |= 1 << (start & 7);
+		start++;
+	}
+	if(end - start >= 8){
+		memset(&scan->coverage[start >> 3], 0xFF, (end - start) >> 3);
+		start += (end - start) & ~7;
+	}
+	while(start < end){
+		scan->coverage[start >> 3] |= 1 << (start & 7);
+		start++;
+	}
+}/*markCoverage*/
+
+
+/*! \brief Write one packet into the scan that is being build
+ *
+ *  \param distances distances of the packet, little endian bytes when raw is true, otherwise int16_t values
+ *
+ *  \retval  1 : a scan has been finished, see sf40ScanLatest
+ *  \retval  0 : the packet has been added
+ *  \retval -1 : the packet doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS, it is ignored
+ *
+ *  \details A packet starts a new scan when its revolution index differs from the scan (this includes the wrap
+ *           from 255 to 0), when the number of points in a revolution has changed or when it doesn't come after
+ *           the previous packet. The scan that was being build is finished at that point, even when points are missing.
+ *           A scan is also finished as soon as its last point has been written.
+ *           Points that were written are marked in the coverage of the scan, the rest is counted in lostPoints.
+ */
+static int addFragment(sf40ScanAssembler_t* assembler, uint8_t revolutionIndex, uint16_t pointTotal, int16_t forwardOffset,
+					   uint16_t pointStartIndex, uint16_t pointCount, const void* distances, bool raw){
+	if(pointTotal == 0 || pointTotal > SF40_MAX_SCAN_POINTS) return -1;
+	if((uint32_t)pointStartIndex + pointCount > pointTotal) return -1;
+
+	int finished = 0;
+	sf40Scan_t* scan = assembler->building;
+	if(assembler->started && (revolutionIndex != scan->revolutionIndex || pointTotal != scan->pointTotal ||
+							  pointStartIndex < assembler->nextIndex)){
+		finishScan(assembler);
+		finished = 1;
+	}
+
+	scan = assembler->building;
+	if(!assembler->started){
+		scan->revolutionIndex = revolutionIndex;
+		scan->pointTotal      = pointTotal;
+		scan->forwardOffset   = forwardOffset;
+		scan->pointsReceived  = 0;
+		scan->lostPoints      = 0;
+		scan->lostRevolutions = 0;
+		if(assembler->finishedOnce){
+			uint8_t jump = (uint8_t)(revolutionIndex - assembler->lastRevolution);
+			if(jump > 1) scan->lostRevolutions = jump - 1;
+		}
+		memset(scan->coverage, 0, (pointTotal + 7) / 8);
+		assembler->started = true;
+	}
+
+	#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	memcpy(&scan->distances[pointStartIndex], distances, pointCount * sizeof(int16_t));
+	#else
+	if(raw){
+		const uint8_t* bytes = distances;
+		for(uint16_t i = 0; i < pointCount; i++){
+			scan->distances[pointStartIndex + i] = (int16_t)(bytes[(i*2)+1]<<8 | bytes[i*2]);
+		}
+	}
+	else memcpy(&scan->distances[pointStartIndex], distances, pointCount * sizeof(int16_t));
+	#endif
+	(void)raw;
+
+	markCoverage(scan, pointStartIndex, pointStartIndex + pointCount);
+	scan->pointsReceived += pointCount;
+	assembler->nextIndex = pointStartIndex + pointCount;
+
+	if(assembler->nextIndex == pointTotal){
+		finishScan(assembler);
+		finished = 1;
+	}
+	return finished;
+}/*addFragment*/
+
+
+/*! \brief Add a packet from acquireStream to the revolution it belongs to
+ *
+ *  \param assembler assembler the packet is added to
+ *
+ *  \param view packet from acquireStream, it can be released right after this call
+ *
+ *  \retval  1 : a scan has been finished, see sf40ScanLatest
+ *  \retval  0 : the packet has been added
+ *  \retval -1 : the packet doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS, it is ignored
+ *
+ *  \details The distances are copied straight from the received packet to their place in the scan.
+ */
+int sf40ScanAddView(sf40ScanAssembler_t* assembler, const streamView_t* view){
+	return addFragment(assembler, view->revolutionIndex, view->pointTotal, view->forwardOffset,
+					   view->pointStartIndex, view->pointCount, view->distances, true);
+}/*sf40ScanAddView*/
+
+
+/*! \brief Add a packet from getStream to the revolution it belongs to
+ *
+ *  \param assembler assembler the packet is added to
+ *
+ *  \param packet packet from getStream
+ *
+ *  \retval  1 : a scan has been finished, see sf40ScanLatest
+ *  \retval  0 : the packet has been added
+ *  \retval -1 : the packet doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS, it is ignored
+ */
+int sf40ScanAddPacket(sf40ScanAssembler_t* assembler, const streamOutput_t* packet){
+	return addFragment(assembler, packet->revolutionIndex, packet->pointTotal, packet->forwardOffset,
+					   packet->pointStartIndex, packet->pointCount, packet->pointDistances, false);
+}/*sf40ScanAddPacket*/
+
+
+/*! \brief Last finished scan
+ *
+ *  \param assembler assembler that builds the scans
+ *
+ *  \return finished scan, NULL when no scan has been finished yet
+ *
+ *  \details No data is copied, the pointer is only valid until the next scan is finished: from then on the packets
+ *           of the revolution after it are written into the same memory. Copy the scan when it is needed longer.
+ *           The assembler doesn't lock, so read the scan on the thread that adds the packets.
+ *           Points that didn't arrive are counted in lostPoints and hold old data, check them with sf40ScanCovered.
+ */
+const sf40Scan_t* sf40ScanLatest(const sf40ScanAssembler_t* assembler){
+	return assembler->finished;
+}/*sf40ScanLatest*/
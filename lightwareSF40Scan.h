@@ -0,0 +1,41 @@
+#ifndef _SF40_SCAN_H_
+#define _SF40_SCAN_H_
+
+    #include <stdint.h>
+    #include <stdbool.h>
+
+    #include "lightwareSF40.h"
+
+    #define SF40_MAX_SCAN_POINTS 8192       // Most points a revolution can hold, change it here so the library is built with the same value
+
+    #define sf40ScanCovered(scan, index) (((scan)->coverage[(index) >> 3] >> ((index) & 7)) & 1)    // true when point index of scan has been received
+
+    // One full revolution of distances
+    typedef struct{
+        uint8_t     revolutionIndex;                    // Revolution index of the packets the scan was build from
+        uint16_t    pointTotal;                         // Number of points in this revolution
+        int16_t     forwardOffset;                      // Orientation offset during this revolution
+        uint16_t    pointsReceived;                     // Number of points that have been filled in
+        uint16_t    lostPoints;                         // Number of points that never arrived, pointTotal - pointsReceived
+        uint8_t     lostRevolutions;                    // Revolutions skipped entirely between the previous scan and this one
+        uint8_t     coverage[(SF40_MAX_SCAN_POINTS + 7) / 8]; // Bit i is set when point i has been received, see sf40ScanCovered
+        int16_t     distances[SF40_MAX_SCAN_POINTS];    // Distance [cm] of each point, at its index in the revolution
+    }sf40Scan_t;
+
+    // Builds complete revolutions out of stream packets, holds the last finished scan and the one that is being build, which swap when it finishes
+    typedef struct{
+        sf40Scan_t  scans[2];
+        sf40Scan_t* building;           // Scan the next packets are written into
+        sf40Scan_t* finished;           // Last finished scan, NULL until the first one is done
+        bool        started;            // true when building holds at least one packet
+        uint16_t    nextIndex;          // Point index right after the last packet written into building
+        bool        finishedOnce;       // true when a scan has been finished before, lastRevolution is set
+        uint8_t     lastRevolution;     // Revolution index of the last finished scan
+    }sf40ScanAssembler_t;
+
+    void sf40ScanInit(sf40ScanAssembler_t* assembler);
+    int sf40ScanAddView(sf40ScanAssembler_t* assembler, const streamView_t* view);
+    int sf40ScanAddPacket(sf40ScanAssembler_t* assembler, const streamOutput_t* packet);
+    const sf40Scan_t* sf40ScanLatest(const sf40ScanAssembler_t* assembler);
+
+#endif
@@ -0,0 +1,91 @@
+/*!
+ *  \file    lightwareSF40Simd.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Choice of the instruction set for the vectorized kernels and the clock,
+ *           shared by every module of the library
+ */
+
+#include "lightwareSF40Simd.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+static atomic_int simdLevel;
+static pthread_once_t simdOnce = PTHREAD_ONCE_INIT;
+
+
+/*! \brief Whether the cpu can run kernels of an instruction set
+ */
+static bool simdSupported(sf40SimdLevel_t level){
+	switch(level){
+		case SF40_SIMD_SCALAR:
+			return true;
+
+		#if defined(SF40_SIMD_X86)
+		case SF40_SIMD_SSE2:
+			return __builtin_cpu_supports("sse2");
+
+		case SF40_SIMD_AVX2:
+			return __builtin_cpu_supports("avx2");
+		#elif defined(SF40_SIMD_NEON)
+		case SF40_SIMD_NEON:
+			return true;
+		#endif
+
+		default:
+			return false;
+	}
+}/*simdSupported*/
+
+
+/*! \brief Pick the widest instruction set the cpu supports, runs once
+ */
+static void selectLevel(void){
+	sf40SimdLevel_t level = SF40_SIMD_SCALAR;
+	if(simdSupported(SF40_SIMD_SSE2)) level = SF40_SIMD_SSE2;
+	if(simdSupported(SF40_SIMD_AVX2)) level = SF40_SIMD_AVX2;
+	if(simdSupported(SF40_SIMD_NEON)) level = SF40_SIMD_NEON;
+	atomic_store_explicit(&simdLevel, level, memory_order_relaxed);
+}/*selectLevel*/
+
+
+/*! \brief Instruction set the kernels use
+ *
+ *  \return widest instruction set the cpu supports, unless another one has been forced
+ */
+sf40SimdLevel_t sf40SimdLevel(void){
+	pthread_once(&simdOnce, selectLevel);
+	return (sf40SimdLevel_t)atomic_load_explicit(&simdLevel, memory_order_relaxed);
+}/*sf40SimdLevel*/
+
+
+/*! \brief Make every module use the kernels of an instruction set
+ *
+ *  \param level instruction set to use
+ *
+ *  \retval  0 : the kernels of level are used from now on
+ *  \retval -1 : the cpu or this build doesn't support level, nothing changed
+ *
+ *  \details Meant for tests and benchmarks that compare the kernels, every instruction set gives the same results.
+ */
+int sf40ForceSimdLevel(sf40SimdLevel_t level){
+	pthread_once(&simdOnce, selectLevel);
+	if(level >= SF40_SIMD_LEVELS || !simdSupported(level)) return -1;
+
+	atomic_store_explicit(&simdLevel, level, memory_order_relaxed);
+	return 0;
+}/*sf40ForceSimdLevel*/
+
+
+/*! \brief Current time of the monotonic clock
+ *
+ *  \return time in microseconds
+ */
+uint64_t sf40MonotonicTime(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}/*sf40MonotonicTime*/
@@ -0,0 +1,65 @@
+#ifndef _SF40_SIMD_H_
+#define _SF40_SIMD_H_
+
+    // Internal to the library: what the vectorized modules share. Applications don't need to include it.
+
+    #include <stdint.h>
+    #include <stdbool.h>
+    #include <stddef.h>
+
+    #if defined(__x86_64__) || defined(__i386__)
+        #include <immintrin.h>
+        #define SF40_SIMD_X86
+    #elif defined(__aarch64__) && !defined(__ARM_BIG_ENDIAN)
+        #include <arm_neon.h>
+        #define SF40_SIMD_NEON
+    #endif
+
+    // Instruction sets the kernels are written for, used as index in a table of kernels
+    typedef enum {
+        SF40_SIMD_SCALAR    = 0,    // Plain C, works on any cpu
+        SF40_SIMD_SSE2      = 1,    // 128 bit x86
+        SF40_SIMD_AVX2      = 2,    // 256 bit x86
+        SF40_SIMD_NEON      = 3,    // 128 bit aarch64
+        SF40_SIMD_LEVELS    = 4
+    } sf40SimdLevel_t;
+
+    // Kernel for the instruction set in use, from a table indexed by sf40SimdLevel_t
+    #define SF40_KERNEL(table) ((table)[sf40SimdLevel()])
+
+    sf40SimdLevel_t sf40SimdLevel(void);
+    int sf40ForceSimdLevel(sf40SimdLevel_t level);
+    uint64_t sf40MonotonicTime(void);
+
+    // Save whether point index is valid, bit index%8 of valid[index/8]; valid can be NULL
+    static inline void sf40SetValid(uint8_t* valid, uint16_t index, bool ok){
+        if(valid == NULL) return;
+
+        if(index % 8 == 0) valid[index / 8] = 0;
+        valid[index / 8] |= (uint8_t)(ok << (index % 8));
+    }
+
+    #if defined(SF40_SIMD_X86)
+    // Validity mask of 8 distances, bit i is set when distance i isn't negative
+    __attribute__((target("sse2")))
+    static inline uint8_t sf40ValidSse2(__m128i distances){
+        return (uint8_t)~_mm_movemask_epi8(_mm_packs_epi16(distances, distances));
+    }
+
+    // Validity mask of 16 distances; packing works per 128 bit lane, so the signs of the second 8 end up in bits 16 to 23
+    __attribute__((target("avx2")))
+    static inline uint16_t sf40ValidAvx2(__m256i distances){
+        uint32_t negative = _mm256_movemask_epi8(_mm256_packs_epi16(distances, distances));
+        return (uint16_t)~((negative & 0xFF) | ((negative >> 8) & 0xFF00));
+    }
+    #endif
+
+    #if defined(SF40_SIMD_NEON)
+    // Validity mask of 8 distances, bit i is set when distance i isn't negative
+    static inline uint8_t sf40ValidNeon(int16x8_t distances){
+        const uint8x8_t bits = {1, 2, 4, 8, 16, 32, 64, 128};
+        return vaddv_u8(vand_u8(vmovn_u16(vcgezq_s16(distances)), bits));
+    }
+    #endif
+
+#endif
@@ -0,0 +1,526 @@
+/*!
+ *  \file    lightwareSF40Transport.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Transports that move the raw bytes between the library and a lidar:
+ *           a termios serial port, an in memory loopback and a replay of a recorded stream.
+ */
+
+#define _GNU_SOURCE
+#include "lightwareSF40Transport.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+
+
+/*! \brief Total amount of bytes in a list of io vectors
+ */
+static size_t chunksSize(const struct iovec* chunks, int count){
+	size_t size = 0;
+	for(int i = 0; i < count; i++) size += chunks[i].iov_len;
+	return size;
+}/*chunksSize*/
+
+
+/*! \brief Convert a relative timeout into a timespec
+ *
+ *  \param timeout timeout [us]
+ */
+static struct timespec toTimespec(uint64_t timeout){
+	struct timespec time = { .tv_sec = timeout / 1000000, .tv_nsec = (timeout % 1000000) * 1000 };
+	return time;
+}/*toTimespec*/
+
+
+/*
+ * Serial port
+ */
+
+typedef struct{
+	sf40Transport_t transport;
+	int             fd;
+}serialTransport_t;
+
+
+static ssize_t serialRead(sf40Transport_t* transport, const struct iovec* chunks, int count){
+	serialTransport_t* serial = (serialTransport_t*)transport;
+
+	// ask how much is waiting so everything is read with a single readv call
+	int waiting = 0;
+	if(ioctl(serial->fd, FIONREAD, &waiting) < 0) waiting = 0;
+	if(waiting <= 0) return 0;
+
+	struct iovec limited[count];
+	int used = 0;
+	size_t left = waiting;
+	for(; used < count && left > 0; used++){
+		limited[used] = chunks[used];
+		if(limited[used].iov_len > left) limited[used].iov_len = left;
+		left -= limited[used].iov_len;
+	}
+
+	ssize_t received = readv(serial->fd, limited, used);
+	if(received < 0) return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+	return received;
+}/*serialRead*/
+
+
+static ssize_t serialWrite(sf40Transport_t* transport, const struct iovec* chunks, int count){
+	serialTransport_t* serial = (serialTransport_t*)transport;
+	size_t total = chunksSize(chunks, count);
+	size_t sent = 0;
+
+	struct iovec remaining[count];
+	memcpy(remaining, chunks, sizeof(struct iovec) * count);
+	struct iovec* next = remaining;
+
+	while(sent < total){
+		ssize_t written = writev(serial->fd, next, count);
+		if(written < 0){
+			if(errno == EINTR) continue;
+			if(errno != EAGAIN) return -1;
+
+			// output buffer of the driver is full, wait until there is room
+			struct pollfd port = { .fd = serial->fd, .events = POLLOUT };
+			if(poll(&port, 1, -1) < 0 && errno != EINTR) return -1;
+			continue;
+		}
+
+		sent += written;
+		while(count > 0 && (size_t)written >= next->iov_len){
+			written -= next->iov_len;
+			next++;
+			count--;
+		}
+		if(count > 0){
+			next->iov_base = (uint8_t*)next->iov_base + written;
+			next->iov_len -= written;
+		}
+	}
+	return sent;
+}/*serialWrite*/
+
+
+static int serialWait(sf40Transport_t* transport, uint64_t timeout){
+	serialTransport_t* serial = (serialTransport_t*)transport;
+	struct pollfd port = { .fd = serial->fd, .events = POLLIN };
+	struct timespec time = toTimespec(timeout);
+
+	int ready = ppoll(&port, 1, &time, NULL);
+	if(ready < 0) return (errno == EINTR) ? 1 : -1;
+	return ready;
+}/*serialWait*/
+
+
+static void serialFlush(sf40Transport_t* transport){
+	tcflush(((serialTransport_t*)transport)->fd, TCIFLUSH);
+}/*serialFlush*/
+
+
+static void serialClose(sf40Transport_t* transport){
+	close(((serialTransport_t*)transport)->fd);
+	free(transport);
+}/*serialClose*/
+
+
+/*! \brief Open a serial port the lidar is connected to
+ *
+ *  \param port tty portname where the lidar is connected to
+ *
+ *  \param baudrate select baudrate that the lidar is expecting
+ *
+ *  \return transport of the serial port, NULL if it couldn't be opened
+ *
+ *  \details The port is set to raw 8N1 without flow control and opened non-blocking.
+ */
+sf40Transport_t* sf40OpenSerial(const char* port, lidarBaudrate_t baudrate){
+	speed_t speed;
+	switch(baudrate){
+		case LIDAR_115K2:
+			speed = B115200;
+			break;
+		case LIDAR_230K4:
+			speed = B230400;
+			break;
+		case LIDAR_460K8:
+			speed = B460800;
+			break;
+		case LIDAR_921K6:
+			speed = B921600;
+			break;
+		default:
+			speed = B115200;
+			break;
+	}
+
+	int fd = open(port, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if(fd < 0){
+		fprintf(stderr, "couldn't open %s: %s\n\r", port, strerror(errno));
+		return NULL;
+	}
+
+	struct termios settings;
+	if(tcgetattr(fd, &settings) < 0){
+		close(fd);
+		return NULL;
+	}
+	cfmakeraw(&settings);
+	settings.c_cflag |= CLOCAL | CREAD;
+	settings.c_cflag &= ~(CSTOPB | CRTSCTS);
+	settings.c_cc[VMIN]  = 0;
+	settings.c_cc[VTIME] = 0;
+	cfsetispeed(&settings, speed);
+	cfsetospeed(&settings, speed);
+	if(tcsetattr(fd, TCSANOW, &settings) < 0){
+		close(fd);
+		return NULL;
+	}
+	tcflush(fd, TCIOFLUSH);
+
+	serialTransport_t* serial = calloc(1, sizeof(serialTransport_t));
+	if(serial == NULL){
+		close(fd);
+		return NULL;
+	}
+
+	serial->fd = fd;
+	serial->transport.read  = serialRead;
+	serial->transport.write = serialWrite;
+	serial->transport.wait  = serialWait;
+	serial->transport.flush = serialFlush;
+	serial->transport.close = serialClose;
+	return &serial->transport;
+}/*sf40OpenSerial*/
+
+
+/*
+ * In memory loopback
+ */
+
+// Buffer handed to a memory transport, it is read from where it is without copying it first
+typedef struct{
+	const uint8_t* data;
+	size_t         size;
+	size_t         used;		// Bytes of data that have already been read
+	sf40Release_t  release;
+	void*          user;
+}segment_t;
+
+typedef struct{
+	sf40Transport_t transport;
+	pthread_mutex_t lock;
+	pthread_cond_t  arrived;
+	segment_t       segments[MEMORY_SEGMENTS];
+	uint32_t        head;				// Total number of buffers handed over
+	uint32_t        tail;				// Total number of buffers read completely
+	uint8_t*        output;				// Bytes written by the library, waiting to be pulled
+	size_t          outputSize;
+	size_t          outputCapacity;
+}memoryTransport_t;
+
+
+/*! \brief Hand back buffers that have been read completely
+ *
+ *  \details Called without holding the lock, so a release function may push the next buffer.
+ */
+static void releaseSegments(segment_t* done, int count){
+	for(int i = 0; i < count; i++){
+		if(done[i].release != NULL) done[i].release(done[i].user, done[i].data);
+	}
+}/*releaseSegments*/
+
+
+static ssize_t memoryRead(sf40Transport_t* transport, const struct iovec* chunks, int count){
+	memoryTransport_t* memory = (memoryTransport_t*)transport;
+	segment_t done[MEMORY_SEGMENTS];
+	int doneCount = 0;
+	size_t received = 0;
+
+	pthread_mutex_lock(&memory->lock);
+	for(int i = 0; i < count; i++){
+		size_t filled = 0;
+		while(filled < chunks[i].iov_len && memory->tail != memory->head){
+			segment_t* segment = &memory->segments[memory->tail % MEMORY_SEGMENTS];
+			size_t size = segment->size - segment->used;
+			if(size > chunks[i].iov_len - filled) size = chunks[i].iov_len - filled;
+
+			memcpy((uint8_t*)chunks[i].iov_base + filled, &segment->data[segment->used], size);
+			segment->used += size;
+			filled += size;
+
+			if(segment->used == segment->size){
+				done[doneCount++] = *segment;
+				memory->tail++;
+			}
+		}
+		received += filled;
+		if(filled < chunks[i].iov_len) break;
+	}
+	pthread_mutex_unlock(&memory->lock);
+
+	releaseSegments(done, doneCount);
+	return received;
+}/*memoryRead*/
+
+
+static ssize_t memoryWrite(sf40Transport_t* transport, const struct iovec* chunks, int count){
+	memoryTransport_t* memory = (memoryTransport_t*)transport;
+	size_t total = chunksSize(chunks, count);
+
+	pthread_mutex_lock(&memory->lock);
+	if(memory->outputSize + total > memory->outputCapacity){
+		size_t capacity = memory->outputCapacity ? memory->outputCapacity : 256;
+		while(capacity < memory->outputSize + total) capacity *= 2;
+
+		uint8_t* output = realloc(memory->output, capacity);
+		if(output == NULL){
+			pthread_mutex_unlock(&memory->lock);
+			return -1;
+		}
+		memory->output = output;
+		memory->outputCapacity = capacity;
+	}
+	for(int i = 0; i < count; i++){
+		memcpy(&memory->output[memory->outputSize], chunks[i].iov_base, chunks[i].iov_len);
+		memory->outputSize += chunks[i].iov_len;
+	}
+	pthread_mutex_unlock(&memory->lock);
+	return total;
+}/*memoryWrite*/
+
+
+static int memoryWait(sf40Transport_t* transport, uint64_t timeout){
+	memoryTransport_t* memory = (memoryTransport_t*)transport;
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec  += timeout / 1000000;
+	deadline.tv_nsec += (timeout % 1000000) * 1000;
+	if(deadline.tv_nsec >= 1000000000){
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	int ready = 1;
+	pthread_mutex_lock(&memory->lock);
+	while(memory->tail == memory->head){
+		if(pthread_cond_timedwait(&memory->arrived, &memory->lock, &deadline) == ETIMEDOUT){
+			ready = (memory->tail != memory->head);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&memory->lock);
+	return ready;
+}/*memoryWait*/
+
+
+static void memoryFlush(sf40Transport_t* transport){
+	memoryTransport_t* memory = (memoryTransport_t*)transport;
+	segment_t done[MEMORY_SEGMENTS];
+	int doneCount = 0;
+
+	pthread_mutex_lock(&memory->lock);
+	while(memory->tail != memory->head){
+		done[doneCount++] = memory->segments[memory->tail % MEMORY_SEGMENTS];
+		memory->tail++;
+	}
+	pthread_mutex_unlock(&memory->lock);
+
+	releaseSegments(done, doneCount);
+}/*memoryFlush*/
+
+
+static void memoryClose(sf40Transport_t* transport){
+	memoryTransport_t* memory = (memoryTransport_t*)transport;
+
+	memoryFlush(transport);
+	pthread_cond_destroy(&memory->arrived);
+	pthread_mutex_destroy(&memory->lock);
+	free(memory->output);
+	free(memory);
+}/*memoryClose*/
+
+
+/*! \brief Create a transport that isn't connected to a lidar, the lidar side is played by the program itself
+ *
+ *  \return transport in memory, NULL if it couldn't be allocated
+ *
+ *  \details Bytes for the library are handed over with sf40MemoryPush,
+ *           bytes written by the library can be taken with sf40MemoryPull.
+ */
+sf40Transport_t* sf40OpenMemory(void){
+	memoryTransport_t* memory = calloc(1, sizeof(memoryTransport_t));
+	if(memory == NULL) return NULL;
+
+	pthread_condattr_t attributes;
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	pthread_cond_init(&memory->arrived, &attributes);
+	pthread_condattr_destroy(&attributes);
+	pthread_mutex_init(&memory->lock, NULL);
+
+	memory->transport.read  = memoryRead;
+	memory->transport.write = memoryWrite;
+	memory->transport.wait  = memoryWait;
+	memory->transport.flush = memoryFlush;
+	memory->transport.close = memoryClose;
+	return &memory->transport;
+}/*sf40OpenMemory*/
+
+
+/*! \brief Hand a buffer to a memory transport, as if the lidar sent it
+ *
+ *  \param transport transport created by sf40OpenMemory
+ *
+ *  \param data bytes to be received by the library
+ *
+ *  \param size number of bytes in data
+ *
+ *  \param release function that is called once data has been read completely, can be NULL
+ *
+ *  \param user pointer that is passed to release
+ *
+ *  \retval  0 : the buffer has been handed over
+ *  \retval -1 : MEMORY_SEGMENTS buffers are already waiting to be read
+ *
+ *  \details The buffer is not copied, it must stay valid until release is called.
+ */
+int sf40MemoryPush(sf40Transport_t* transport, const uint8_t* data, size_t size, sf40Release_t release, void* user){
+	memoryTransport_t* memory = (memoryTransport_t*)transport;
+	if(size == 0){
+		if(release != NULL) release(user, data);
+		return 0;
+	}
+
+	pthread_mutex_lock(&memory->lock);
+	if(memory->head - memory->tail >= MEMORY_SEGMENTS){
+		pthread_mutex_unlock(&memory->lock);
+		return -1;
+	}
+
+	segment_t* segment = &memory->segments[memory->head % MEMORY_SEGMENTS];
+	segment->data    = data;
+	segment->size    = size;
+	segment->used    = 0;
+	segment->release = release;
+	segment->user    = user;
+	memory->head++;
+
+	pthread_cond_signal(&memory->arrived);
+	pthread_mutex_unlock(&memory->lock);
+	return 0;
+}/*sf40MemoryPush*/
+
+
+/*! \brief Take the bytes the library has written to a memory transport
+ *
+ *  \param transport transport created by sf40OpenMemory
+ *
+ *  \param data location where the bytes need to be saved
+ *
+ *  \param size maximum number of bytes to take
+ *
+ *  \return Amount of bytes that have been copied
+ */
+size_t sf40MemoryPull(sf40Transport_t* transport, uint8_t* data, size_t size){
+	memoryTransport_t* memory = (memoryTransport_t*)transport;
+
+	pthread_mutex_lock(&memory->lock);
+	if(size > memory->outputSize) size = memory->outputSize;
+	if(size > 0){
+		memcpy(data, memory->output, size);
+		memory->outputSize -= size;
+		memmove(memory->output, &memory->output[size], memory->outputSize);
+	}
+	pthread_mutex_unlock(&memory->lock);
+	return size;
+}/*sf40MemoryPull*/
+
+
+/*
+ * Replay of a recorded stream
+ */
+
+typedef struct{
+	sf40Transport_t transport;
+	int             fd;
+	bool            ended;		// Whole recording has been read
+}replayTransport_t;
+
+
+static ssize_t replayRead(sf40Transport_t* transport, const struct iovec* chunks, int count){
+	replayTransport_t* replay = (replayTransport_t*)transport;
+
+	ssize_t received = readv(replay->fd, chunks, count);
+	if(received < 0) return (errno == EINTR) ? 0 : -1;
+	if(received == 0 && chunksSize(chunks, count) > 0) replay->ended = true;
+	return received;
+}/*replayRead*/
+
+
+static ssize_t replayWrite(sf40Transport_t* transport, const struct iovec* chunks, int count){
+	(void)transport;
+	return chunksSize(chunks, count);
+}/*replayWrite*/
+
+
+static int replayWait(sf40Transport_t* transport, uint64_t timeout){
+	replayTransport_t* replay = (replayTransport_t*)transport;
+	if(!replay->ended) return 1;
+
+	struct timespec time = toTimespec(timeout);
+	nanosleep(&time, NULL);
+	return 0;
+}/*replayWait*/
+
+
+static void replayFlush(sf40Transport_t* transport){
+	(void)transport;
+}/*replayFlush*/
+
+
+static void replayClose(sf40Transport_t* transport){
+	close(((replayTransport_t*)transport)->fd);
+	free(transport);
+}/*replayClose*/
+
+
+/*! \brief Replay a recorded stream of raw bytes received from a lidar
+ *
+ *  \param path file with the recorded bytes
+ *
+ *  \return transport reading the file, NULL if it couldn't be opened
+ *
+ *  \details The recording is read as fast as the library asks for it. Everything the library
+ *           writes is dropped and flushing doesn't skip recorded data.
+ */
+sf40Transport_t* sf40OpenReplay(const char* path){
+	int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		fprintf(stderr, "couldn't open %s: %s\n\r", path, strerror(errno));
+		return NULL;
+	}
+
+	replayTransport_t* replay = calloc(1, sizeof(replayTransport_t));
+	if(replay == NULL){
+		close(fd);
+		return NULL;
+	}
+
+	replay->fd = fd;
+	replay->transport.read  = replayRead;
+	replay->transport.write = replayWrite;
+	replay->transport.wait  = replayWait;
+	replay->transport.flush = replayFlush;
+	replay->transport.close = replayClose;
+	return &replay->transport;
+}/*sf40OpenReplay*/
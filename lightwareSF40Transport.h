@@ -0,0 +1,41 @@
+#ifndef _SF40_TRANSPORT_H_
+#define _SF40_TRANSPORT_H_
+
+    #include <stdint.h>
+    #include <stddef.h>
+    #include <stdbool.h>
+    #include <sys/types.h>
+    #include <sys/uio.h>
+
+    #include "lightwareSF40.h"
+
+    #define MEMORY_SEGMENTS 64              // Buffers that can be handed to a memory transport at once
+
+    /*
+     * A transport moves the raw bytes between the library and a lidar.
+     * Every function gets the transport itself, implementations put it as the first member of their own struct.
+     */
+    struct sf40Transport{
+        // Read the bytes that have already arrived without waiting, returns the amount read or -1 on failure
+        ssize_t (*read)(sf40Transport_t* transport, const struct iovec* chunks, int count);
+        // Write all bytes, returns the amount written or -1 on failure
+        ssize_t (*write)(sf40Transport_t* transport, const struct iovec* chunks, int count);
+        // Sleep until there are bytes to read, returns 1 when there are, 0 after the timeout [us] and -1 on failure
+        int     (*wait)(sf40Transport_t* transport, uint64_t timeout);
+        // Drop every byte that has arrived but hasn't been read yet
+        void    (*flush)(sf40Transport_t* transport);
+        // Close the connection and free the transport
+        void    (*close)(sf40Transport_t* transport);
+    };
+
+    // Called when a buffer handed to a memory transport has been read completely
+    typedef void (*sf40Release_t)(void* user, const uint8_t* data);
+
+    sf40Transport_t* sf40OpenSerial(const char* port, lidarBaudrate_t baudrate);
+    sf40Transport_t* sf40OpenMemory(void);
+    sf40Transport_t* sf40OpenReplay(const char* path);
+
+    int sf40MemoryPush(sf40Transport_t* transport, const uint8_t* data, size_t size, sf40Release_t release, void* user);
+    size_t sf40MemoryPull(sf40Transport_t* transport, uint8_t* data, size_t size);
+
+#endif
@@ -0,0 +1,274 @@
+/*!
+ *  \file    lightwareSF40Tree.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Segment tree over the distances of a revolution, answers the closest and furthest point
+ *           between any two angles in O(log n) and is updated packet by packet
+ */
+
+#include "lightwareSF40Tree.h"
+#include <stdbool.h>
+
+
+/*! \brief Combine two nodes into their parent
+ *
+ *  \details Of equal closest distances the lowest index is kept, so the order in which nodes are combined doesn't matter.
+ */
+static inline void combine(int16_t* closest, uint16_t* closestIndex, int16_t* furthest,
+						   int16_t leftClosest, uint16_t leftIndex, int16_t leftFurthest,
+						   int16_t rightClosest, uint16_t rightIndex, int16_t rightFurthest){
+	if(rightClosest < leftClosest || (rightClosest == leftClosest && rightIndex < leftIndex)){
+		*closest = rightClosest;
+		*closestIndex = rightIndex;
+	}
+	else{
+		*closest = leftClosest;
+		*closestIndex = leftIndex;
+	}
+	*furthest = (rightFurthest > leftFurthest) ? rightFurthest : leftFurthest;
+}/*combine*/
+
+
+/*! \brief Recompute a node from its two children
+ */
+static inline void pullNode(sf40RangeTree_t* tree, uint32_t node){
+	combine(&tree->closest[node], &tree->closestIndex[node], &tree->furthest[node],
+			tree->closest[node * 2], tree->closestIndex[node * 2], tree->furthest[node * 2],
+			tree->closest[node * 2 + 1], tree->closestIndex[node * 2 + 1], tree->furthest[node * 2 + 1]);
+}/*pullNode*/
+
+
+/*! \brief Save the distance of a point in its leaf
+ *
+ *  \details Negative distances are invalid and get the values that never win a comparison.
+ */
+static inline void setLeaf(sf40RangeTree_t* tree, uint16_t index, int16_t distance, bool received){
+	uint32_t leaf = tree->pointTotal + index;
+	bool valid = received && distance >= 0;
+	tree->closest[leaf]      = valid ? distance : INT16_MAX;
+	tree->closestIndex[leaf] = index;
+	tree->furthest[leaf]     = valid ? distance : -1;
+}/*setLeaf*/
+
+
+/*! \brief Start the tree over for a revolution with another number of points
+ *
+ *  \details Every point is invalid until it has been added.
+ */
+static void resetTree(sf40RangeTree_t* tree, uint16_t pointTotal){
+	tree->pointTotal = pointTotal;
+	for(uint16_t i = 0; i < pointTotal; i++) setLeaf(tree, i, -1, false);
+	for(uint32_t node = pointTotal - 1; node >= 1; node--) pullNode(tree, node);
+}/*resetTree*/
+
+
+/*! \brief Recompute every node above the leaves from first up to end
+ *
+ *  \details Only the parents of the changed leaves are visited, one range per level, so adding a packet costs
+ *           O(pointCount + log n) instead of rebuilding the whole tree.
+ */
+static void pullRange(sf40RangeTree_t* tree, uint16_t first, uint16_t end){
+	uint32_t low  = (tree->pointTotal + first) >> 1;
+	uint32_t high = (tree->pointTotal + end - 1) >> 1;
+	while(low >= 1){
+		for(uint32_t node = high; node >= low; node--) pullNode(tree, node);
+		low >>= 1;
+		high >>= 1;
+	}
+}/*pullRange*/
+
+
+/*! \brief Write the distances of a packet into the tree
+ *
+ *  \param distances distances of the packet, little endian bytes when raw is true, otherwise int16_t values
+ *
+ *  \retval  0 : the points have been added
+ *  \retval -1 : the packet doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS, it is ignored
+ */
+static int addFragment(sf40RangeTree_t* tree, uint16_t pointTotal, int16_t forwardOffset, uint16_t pointStartIndex,
+					   uint16_t pointCount, const void* distances, bool raw){
+	if(pointTotal == 0 || pointTotal > SF40_MAX_SCAN_POINTS) return -1;
+	if((uint32_t)pointStartIndex + pointCount > pointTotal) return -1;
+	if(pointCount == 0) return 0;
+
+	if(pointTotal != tree->pointTotal) resetTree(tree, pointTotal);
+	tree->forwardOffset = forwardOffset;
+
+	if(raw){
+		const uint8_t* bytes = distances;
+		for(uint16_t i = 0; i < pointCount; i++){
+			setLeaf(tree, pointStartIndex + i, (int16_t)(bytes[(i*2)+1]<<8 | bytes[i*2]), true);
+		}
+	}
+	else{
+		const int16_t* values = distances;
+		for(uint16_t i = 0; i < pointCount; i++) setLeaf(tree, pointStartIndex + i, values[i], true);
+	}
+
+	pullRange(tree, pointStartIndex, pointStartIndex + pointCount);
+	return 0;
+}/*addFragment*/
+
+
+/*! \brief Prepare a tree for its first revolution
+ *
+ *  \param tree tree that needs to be prepared
+ */
+void sf40TreeInit(sf40RangeTree_t* tree){
+	tree->pointTotal = 0;
+	tree->forwardOffset = 0;
+}/*sf40TreeInit*/
+
+
+/*! \brief Build the tree from a complete scan
+ *
+ *  \param tree tree that is build
+ *
+ *  \param scan scan from sf40ScanLatest
+ *
+ *  \retval  0 : the tree holds the scan
+ *  \retval -1 : there is no scan or it is larger than SF40_MAX_SCAN_POINTS
+ *
+ *  \details Points that haven't been received in the scan are left out. Building takes O(n).
+ */
+int sf40TreeBuild(sf40RangeTree_t* tree, const sf40Scan_t* scan){
+	if(scan == NULL || scan->pointTotal == 0 || scan->pointTotal > SF40_MAX_SCAN_POINTS) return -1;
+
+	tree->pointTotal = scan->pointTotal;
+	tree->forwardOffset = scan->forwardOffset;
+	for(uint16_t i = 0; i < scan->pointTotal; i++) setLeaf(tree, i, scan->distances[i], sf40ScanCovered(scan, i));
+	for(uint32_t node = scan->pointTotal - 1; node >= 1; node--) pullNode(tree, node);
+	return 0;
+}/*sf40TreeBuild*/
+
+
+/*! \brief Update the tree with a packet from acquireStream
+ *
+ *  \param tree tree that is updated
+ *
+ *  \param view packet from acquireStream, it can be released right after this call
+ *
+ *  \retval  0 : the points have been added
+ *  \retval -1 : the packet doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS, it is ignored
+ *
+ *  \details Every point keeps the last distance that has been added for it, so the tree always holds the newest
+ *           revolution. When pointTotal changes the tree is started over.
+ */
+int sf40TreeAddView(sf40RangeTree_t* tree, const streamView_t* view){
+	return addFragment(tree, view->pointTotal, view->forwardOffset, view->pointStartIndex, view->pointCount,
+					   view->distances, true);
+}/*sf40TreeAddView*/
+
+
+/*! \brief Update the tree with a packet from getStream
+ *
+ *  \param tree tree that is updated
+ *
+ *  \param packet packet from getStream
+ *
+ *  \retval  0 : the points have been added
+ *  \retval -1 : the packet doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS, it is ignored
+ *
+ *  \details Same as sf40TreeAddView.
+ */
+int sf40TreeAddPacket(sf40RangeTree_t* tree, const streamOutput_t* packet){
+	return addFragment(tree, packet->pointTotal, packet->forwardOffset, packet->pointStartIndex, packet->pointCount,
+					   packet->pointDistances, false);
+}/*sf40TreeAddPacket*/
+
+
+/*! \brief Closest and furthest point between two points of the revolution
+ *
+ *  \param tree tree of the revolution
+ *
+ *  \param first index of the first point
+ *
+ *  \param last index of the last point, the range passes the end of the revolution when it is below first
+ *
+ *  \param result location where the closest and furthest point need to be saved
+ *
+ *  \retval  0 : the range holds a valid point
+ *  \retval -1 : the range holds no valid point, or an index is outside the revolution
+ *
+ *  \details Takes O(log n). Of equal closest distances the lowest index is taken.
+ */
+int sf40TreeQuery(const sf40RangeTree_t* tree, uint16_t first, uint16_t last, sf40RangeResult_t* result){
+	uint16_t total = tree->pointTotal;
+	if(total == 0 || first >= total || last >= total) return -1;
+
+	int16_t closest = INT16_MAX;
+	uint16_t closestIndex = 0;
+	int16_t furthest = -1;
+
+	// a range passing the end of the revolution is taken as two ranges
+	uint16_t ranges[2][2] = { {first, (last >= first) ? last + 1 : total}, {0, (last >= first) ? 0 : last + 1} };
+	for(int range = 0; range < 2; range++){
+		uint32_t low  = total + ranges[range][0];
+		uint32_t high = total + ranges[range][1];
+		while(low < high){
+			if(low & 1){
+				combine(&closest, &closestIndex, &furthest, closest, closestIndex, furthest,
+						tree->closest[low], tree->closestIndex[low], tree->furthest[low]);
+				low++;
+			}
+			if(high & 1){
+				high--;
+				combine(&closest, &closestIndex, &furthest, closest, closestIndex, furthest,
+						tree->closest[high], tree->closestIndex[high], tree->furthest[high]);
+			}
+			low >>= 1;
+			high >>= 1;
+		}
+	}
+	if(furthest < 0) return -1;
+
+	int32_t angle = (int32_t)((int64_t)closestIndex * 3600 / total) + tree->forwardOffset * 10;
+	result->closestDistance  = closest;
+	result->closestIndex     = closestIndex;
+	result->angle            = (int16_t)(((angle % 3600) + 3600) % 3600);
+	result->furthestDistance = furthest;
+	return 0;
+}/*sf40TreeQuery*/
+
+
+/*! \brief Round a division down, also for negative numerators
+ */
+static inline int32_t floorDivide(int32_t numerator, int32_t denominator){
+	int32_t quotient = numerator / denominator;
+	return quotient - ((numerator % denominator != 0) && ((numerator < 0) != (denominator < 0)));
+}/*floorDivide*/
+
+
+/*! \brief Closest and furthest point between two angles
+ *
+ *  \param tree tree of the revolution
+ *
+ *  \param from angle where the range starts [10ths of a degree]
+ *
+ *  \param to angle where the range ends [10ths of a degree], the range goes up from from and passes 360 degrees when to is below from
+ *
+ *  \param result location where the closest and furthest point need to be saved
+ *
+ *  \retval  0 : the range holds a valid point
+ *  \retval -1 : the range holds no valid point
+ *
+ *  \details Point i lies at i * 360 / pointTotal + forwardOffset degrees, the points on both ends are part of the range.
+ */
+int sf40TreeQueryAngles(const sf40RangeTree_t* tree, int16_t from, int16_t to, sf40RangeResult_t* result){
+	int32_t total = tree->pointTotal;
+	if(total == 0) return -1;
+
+	int32_t span  = (((int32_t)to - from) % 3600 + 3600) % 3600;
+	int32_t start = (int32_t)from - tree->forwardOffset * 10;
+	int32_t low   = -floorDivide(-start * total, 3600);
+	int32_t high  = floorDivide((start + span) * total, 3600);
+
+	int32_t points = high - low + 1;
+	if(points <= 0) return -1;
+	if(points > total) points = total;
+
+	int32_t first = ((low % total) + total) % total;
+	return sf40TreeQuery(tree, (uint16_t)first, (uint16_t)((first + points - 1) % total), result);
+}/*sf40TreeQueryAngles*/
@@ -0,0 +1,32 @@
+#ifndef _SF40_TREE_H_
+#define _SF40_TREE_H_
+
+    #include <stdint.h>
+
+    #include "lightwareSF40.h"
+    #include "lightwareSF40Scan.h"
+
+    // Segment tree over the distances of a revolution, node i holds nodes 2i and 2i+1 and the points are the nodes from pointTotal on
+    typedef struct{
+        uint16_t    pointTotal;                             // Number of points in the revolution, 0 when nothing has been added
+        int16_t     forwardOffset;                          // Orientation offset of the last added points
+        int16_t     closest[SF40_MAX_SCAN_POINTS * 2];      // Closest distance [cm] below each node, INT16_MAX when no point is valid
+        uint16_t    closestIndex[SF40_MAX_SCAN_POINTS * 2]; // Index of the first point at the closest distance below each node
+        int16_t     furthest[SF40_MAX_SCAN_POINTS * 2];     // Furthest distance [cm] below each node, -1 when no point is valid
+    }sf40RangeTree_t;
+
+    typedef struct{
+        int16_t     closestDistance;    // Closest distance [cm]
+        uint16_t    closestIndex;       // Index of the closest point in the revolution
+        int16_t     angle;              // Angle to closest distance [10ths of a degree]
+        int16_t     furthestDistance;   // Furthest distance [cm]
+    }sf40RangeResult_t;
+
+    void sf40TreeInit(sf40RangeTree_t* tree);
+    int sf40TreeBuild(sf40RangeTree_t* tree, const sf40Scan_t* scan);
+    int sf40TreeAddView(sf40RangeTree_t* tree, const streamView_t* view);
+    int sf40TreeAddPacket(sf40RangeTree_t* tree, const streamOutput_t* packet);
+    int sf40TreeQuery(const sf40RangeTree_t* tree, uint16_t first, uint16_t last, sf40RangeResult_t* result);
+    int sf40TreeQueryAngles(const sf40RangeTree_t* tree, int16_t from, int16_t to, sf40RangeResult_t* result);
+
+#endif
@@ -0,0 +1,514 @@
+/*!
+ *  \file    lightwareSF40Zones.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Software alarm zones: sectors like the hardware alarms and polygons,
+ *           as many as needed, checked against every stream packet
+ */
+
+#include "lightwareSF40Zones.h"
+#include "lightwareSF40Cartesian.h"
+#include "lightwareSF40Simd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// One side of a polygon, prepared for the crossing test
+typedef struct{
+	float x;		// x [m] of the corner the side starts at
+	float y;		// y [m] of the corner the side starts at
+	float yEnd;		// y [m] of the corner the side ends at
+	float slope;	// change of x for every meter of y along the side
+}edge_t;
+
+typedef struct{
+	bool     enabled;		// false when the zone is never checked
+	bool     polygon;		// true for a polygon, false for a sector
+	bool     triggered;		// true from the packet that entered the zone until it has been clear for a revolution
+	uint32_t clear;			// Points the zone has been clear for since it was last entered
+
+	float    range;			// Sector: distance [m] within which a point enters the zone
+	float    directionX;	// Sector: cos of the direction
+	float    directionY;	// Sector: sin of the direction
+	float    spread;		// Sector: cos of half the width, -2 for a sector all the way around
+
+	edge_t*  edges;			// Polygon: the sides
+	uint16_t edgeCount;		// Polygon: number of sides
+	float    box[4];		// Polygon: lowest x, highest x, lowest y, highest y [m]
+}zone_t;
+
+struct sf40Zones{
+	zone_t*          zones;
+	uint32_t         count;
+	uint32_t         capacity;
+	sf40ZoneEvent_t  event;
+	void*            user;
+	sf40AngleTable_t angles;
+	float            x[SF40_MAX_STREAM_POINTS];
+	float            y[SF40_MAX_STREAM_POINTS];
+	uint8_t          valid[SF40_VALID_BYTES(SF40_MAX_STREAM_POINTS)];
+};
+
+typedef uint16_t (*zoneKernel_t)(const zone_t* zone, const float* x, const float* y, uint16_t count);
+
+
+/*! \brief Count the points inside a sector one point at a time
+ *
+ *  \details A point is inside when it is within range and the angle to the direction is at most half the width,
+ *           which is the same as x * directionX + y * directionY >= distance * spread.
+ *           A point at distance 0 has no direction and is never inside.
+ *           Invalid points are NaN and never inside.
+ */
+static uint16_t sectorScalar(const zone_t* zone, const float* x, const float* y, uint16_t count){
+	uint16_t inside = 0;
+	for(uint16_t i = 0; i < count; i++){
+		float distance = sqrtf(x[i] * x[i] + y[i] * y[i]);
+		inside += (distance > 0) && (distance <= zone->range) && (x[i] * zone->directionX + y[i] * zone->directionY >= distance * zone->spread);
+	}
+	return inside;
+}/*sectorScalar*/
+
+
+/*! \brief Count the points inside a polygon one point at a time
+ *
+ *  \details Crossing test: a point is inside when a line from it towards +x crosses the sides an odd number of times.
+ *           Invalid points are NaN, every comparison with them is false so they are never inside.
+ */
+static uint16_t polygonScalar(const zone_t* zone, const float* x, const float* y, uint16_t count){
+	uint16_t inside = 0;
+	for(uint16_t i = 0; i < count; i++){
+		if(!(x[i] >= zone->box[0] && x[i] <= zone->box[1] && y[i] >= zone->box[2] && y[i] <= zone->box[3])) continue;
+
+		bool crossed = false;
+		for(uint16_t e = 0; e < zone->edgeCount; e++){
+			const edge_t* edge = &zone->edges[e];
+			if(((edge->y > y[i]) != (edge->yEnd > y[i])) && (x[i] < edge->x + (y[i] - edge->y) * edge->slope)) crossed = !crossed;
+		}
+		inside += crossed;
+	}
+	return inside;
+}/*polygonScalar*/
+
+
+#if defined(SF40_SIMD_X86)
+/*! \brief Count the points inside a sector, 4 points at a time
+ */
+__attribute__((target("sse2")))
+static uint16_t sectorSse2(const zone_t* zone, const float* x, const float* y, uint16_t count){
+	const __m128 range  = _mm_set1_ps(zone->range);
+	const __m128 dirX   = _mm_set1_ps(zone->directionX);
+	const __m128 dirY   = _mm_set1_ps(zone->directionY);
+	const __m128 spread = _mm_set1_ps(zone->spread);
+	uint16_t inside = 0;
+	uint16_t i = 0;
+
+	for(; i + 4 <= count; i += 4){
+		__m128 px = _mm_loadu_ps(&x[i]);
+		__m128 py = _mm_loadu_ps(&y[i]);
+		__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)));
+		__m128 ahead = _mm_add_ps(_mm_mul_ps(px, dirX), _mm_mul_ps(py, dirY));
+		__m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(distance, _mm_setzero_ps()), _mm_cmple_ps(distance, range)),
+								 _mm_cmpge_ps(ahead, _mm_mul_ps(distance, spread)));
+		inside += __builtin_popcount(_mm_movemask_ps(hit));
+	}
+	return inside + sectorScalar(zone, &x[i], &y[i], count - i);
+}/*sectorSse2*/
+
+
+/*! \brief Count the points inside a polygon, 4 points at a time
+ *
+ *  \details The sides are only gone through when one of the 4 points is inside the bounding box.
+ */
+__attribute__((target("sse2")))
+static uint16_t polygonSse2(const zone_t* zone, const float* x, const float* y, uint16_t count){
+	uint16_t inside = 0;
+	uint16_t i = 0;
+
+	for(; i + 4 <= count; i += 4){
+		__m128 px = _mm_loadu_ps(&x[i]);
+		__m128 py = _mm_loadu_ps(&y[i]);
+		__m128 boxed = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(px, _mm_set1_ps(zone->box[0])), _mm_cmple_ps(px, _mm_set1_ps(zone->box[1]))),
+								  _mm_and_ps(_mm_cmpge_ps(py, _mm_set1_ps(zone->box[2])), _mm_cmple_ps(py, _mm_set1_ps(zone->box[3]))));
+		if(_mm_movemask_ps(boxed) == 0) continue;
+
+		__m128 crossed = _mm_setzero_ps();
+		for(uint16_t e = 0; e < zone->edgeCount; e++){
+			const edge_t* edge = &zone->edges[e];
+			__m128 spans = _mm_xor_ps(_mm_cmpgt_ps(_mm_set1_ps(edge->y), py), _mm_cmpgt_ps(_mm_set1_ps(edge->yEnd), py));
+			__m128 cross = _mm_add_ps(_mm_set1_ps(edge->x), _mm_mul_ps(_mm_sub_ps(py, _mm_set1_ps(edge->y)), _mm_set1_ps(edge->slope)));
+			crossed = _mm_xor_ps(crossed, _mm_and_ps(spans, _mm_cmplt_ps(px, cross)));
+		}
+		inside += __builtin_popcount(_mm_movemask_ps(_mm_and_ps(crossed, boxed)));
+	}
+	return inside + polygonScalar(zone, &x[i], &y[i], count - i);
+}/*polygonSse2*/
+
+
+/*! \brief Count the points inside a sector, 8 points at a time
+ */
+__attribute__((target("avx2")))
+static uint16_t sectorAvx2(const zone_t* zone, const float* x, const float* y, uint16_t count){
+	const __m256 range  = _mm256_set1_ps(zone->range);
+	const __m256 dirX   = _mm256_set1_ps(zone->directionX);
+	const __m256 dirY   = _mm256_set1_ps(zone->directionY);
+	const __m256 spread = _mm256_set1_ps(zone->spread);
+	uint16_t inside = 0;
+	uint16_t i = 0;
+
+	for(; i + 8 <= count; i += 8){
+		__m256 px = _mm256_loadu_ps(&x[i]);
+		__m256 py = _mm256_loadu_ps(&y[i]);
+		__m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(px, px), _mm256_mul_ps(py, py)));
+		__m256 ahead = _mm256_add_ps(_mm256_mul_ps(px, dirX), _mm256_mul_ps(py, dirY));
+		__m256 hit = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_cmp_ps(distance, range, _CMP_LE_OQ)),
+								   _mm256_cmp_ps(ahead, _mm256_mul_ps(distance, spread), _CMP_GE_OQ));
+		inside += __builtin_popcount(_mm256_movemask_ps(hit));
+	}
+	return inside + sectorSse2(zone, &x[i], &y[i], count - i);
+}/*sectorAvx2*/
+
+
+/*! \brief Count the points inside a polygon, 8 points at a time
+ */
+__attribute__((target("avx2")))
+static uint16_t polygonAvx2(const zone_t* zone, const float* x, const float* y, uint16_t count){
+	uint16_t inside = 0;
+	uint16_t i = 0;
+
+	for(; i + 8 <= count; i += 8){
+		__m256 px = _mm256_loadu_ps(&x[i]);
+		__m256 py = _mm256_loadu_ps(&y[i]);
+		__m256 boxed = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(px, _mm256_set1_ps(zone->box[0]), _CMP_GE_OQ),
+												   _mm256_cmp_ps(px, _mm256_set1_ps(zone->box[1]), _CMP_LE_OQ)),
+									 _mm256_and_ps(_mm256_cmp_ps(py, _mm256_set1_ps(zone->box[2]), _CMP_GE_OQ),
+												   _mm256_cmp_ps(py, _mm256_set1_ps(zone->box[3]), _CMP_LE_OQ)));
+		if(_mm256_movemask_ps(boxed) == 0) continue;
+
+		__m256 crossed = _mm256_setzero_ps();
+		for(uint16_t e = 0; e < zone->edgeCount; e++){
+			const edge_t* edge = &zone->edges[e];
+			__m256 spans = _mm256_xor_ps(_mm256_cmp_ps(_mm256_set1_ps(edge->y), py, _CMP_GT_OQ),
+										 _mm256_cmp_ps(_mm256_set1_ps(edge->yEnd), py, _CMP_GT_OQ));
+			__m256 cross = _mm256_add_ps(_mm256_set1_ps(edge->x), _mm256_mul_ps(_mm256_sub_ps(py, _mm256_set1_ps(edge->y)), _mm256_set1_ps(edge->slope)));
+			crossed = _mm256_xor_ps(crossed, _mm256_and_ps(spans, _mm256_cmp_ps(px, cross, _CMP_LT_OQ)));
+		}
+		inside += __builtin_popcount(_mm256_movemask_ps(_mm256_and_ps(crossed, boxed)));
+	}
+	return inside + polygonSse2(zone, &x[i], &y[i], count - i);
+}/*polygonAvx2*/
+#endif
+
+
+#if defined(SF40_SIMD_NEON)
+/*! \brief Count the points inside a sector, 4 points at a time
+ */
+static uint16_t sectorNeon(const zone_t* zone, const float* x, const float* y, uint16_t count){
+	uint16_t inside = 0;
+	uint16_t i = 0;
+
+	for(; i + 4 <= count; i += 4){
+		float32x4_t px = vld1q_f32(&x[i]);
+		float32x4_t py = vld1q_f32(&y[i]);
+		float32x4_t distance = vsqrtq_f32(vaddq_f32(vmulq_f32(px, px), vmulq_f32(py, py)));
+		float32x4_t ahead = vaddq_f32(vmulq_n_f32(px, zone->directionX), vmulq_n_f32(py, zone->directionY));
+		uint32x4_t hit = vandq_u32(vandq_u32(vcgtq_f32(distance, vdupq_n_f32(0.0f)), vcleq_f32(distance, vdupq_n_f32(zone->range))),
+								   vcgeq_f32(ahead, vmulq_n_f32(distance, zone->spread)));
+		inside += vaddvq_u32(vshrq_n_u32(hit, 31));
+	}
+	return inside + sectorScalar(zone, &x[i], &y[i], count - i);
+}/*sectorNeon*/
+
+
+/*! \brief Count the points inside a polygon, 4 points at a time
+ */
+static uint16_t polygonNeon(const zone_t* zone, const float* x, const float* y, uint16_t count){
+	uint16_t inside = 0;
+	uint16_t i = 0;
+
+	for(; i + 4 <= count; i += 4){
+		float32x4_t px = vld1q_f32(&x[i]);
+		float32x4_t py = vld1q_f32(&y[i]);
+		uint32x4_t boxed = vandq_u32(vandq_u32(vcgeq_f32(px, vdupq_n_f32(zone->box[0])), vcleq_f32(px, vdupq_n_f32(zone->box[1]))),
+									 vandq_u32(vcgeq_f32(py, vdupq_n_f32(zone->box[2])), vcleq_f32(py, vdupq_n_f32(zone->box[3]))));
+		if(vmaxvq_u32(boxed) == 0) continue;
+
+		uint32x4_t crossed = vdupq_n_u32(0);
+		for(uint16_t e = 0; e < zone->edgeCount; e++){
+			const edge_t* edge = &zone->edges[e];
+			uint32x4_t spans = veorq_u32(vcgtq_f32(vdupq_n_f32(edge->y), py), vcgtq_f32(vdupq_n_f32(edge->yEnd), py));
+			float32x4_t cross = vaddq_f32(vdupq_n_f32(edge->x), vmulq_n_f32(vsubq_f32(py, vdupq_n_f32(edge->y)), edge->slope));
+			crossed = veorq_u32(crossed, vandq_u32(spans, vcltq_f32(px, cross)));
+		}
+		inside += vaddvq_u32(vshrq_n_u32(vandq_u32(crossed, boxed), 31));
+	}
+	return inside + polygonScalar(zone, &x[i], &y[i], count - i);
+}/*polygonNeon*/
+#endif
+
+
+// Kernels of every instruction set, SF40_KERNEL picks the one the cpu supports
+static const zoneKernel_t sectorKernels[SF40_SIMD_LEVELS] = {
+	[SF40_SIMD_SCALAR] = sectorScalar,
+	#if defined(SF40_SIMD_X86)
+	[SF40_SIMD_SSE2]   = sectorSse2,
+	[SF40_SIMD_AVX2]   = sectorAvx2,
+	#elif defined(SF40_SIMD_NEON)
+	[SF40_SIMD_NEON]   = sectorNeon,
+	#endif
+};
+
+static const zoneKernel_t polygonKernels[SF40_SIMD_LEVELS] = {
+	[SF40_SIMD_SCALAR] = polygonScalar,
+	#if defined(SF40_SIMD_X86)
+	[SF40_SIMD_SSE2]   = polygonSse2,
+	[SF40_SIMD_AVX2]   = polygonAvx2,
+	#elif defined(SF40_SIMD_NEON)
+	[SF40_SIMD_NEON]   = polygonNeon,
+	#endif
+};
+
+
+/*! \brief Create an empty set of zones
+ *
+ *  \param event called when a zone is entered or cleared, can be NULL
+ *
+ *  \param user passed to event
+ *
+ *  \return set of zones, NULL if it couldn't be allocated
+ */
+sf40Zones_t* sf40CreateZones(sf40ZoneEvent_t event, void* user){
+	sf40Zones_t* zones = calloc(1, sizeof(sf40Zones_t));
+	if(zones == NULL) return NULL;
+
+	zones->event = event;
+	zones->user = user;
+	sf40AngleTableInit(&zones->angles);
+	return zones;
+}/*sf40CreateZones*/
+
+
+/*! \brief Free a set of zones and every zone in it
+ *
+ *  \param zones set of zones
+ */
+void sf40FreeZones(sf40Zones_t* zones){
+	if(zones == NULL) return;
+
+	for(uint32_t i = 0; i < zones->count; i++) free(zones->zones[i].edges);
+	free(zones->zones);
+	free(zones);
+}/*sf40FreeZones*/
+
+
+/*! \brief Make room for one more zone
+ *
+ *  \return new zone, NULL if there was no room
+ */
+static zone_t* newZone(sf40Zones_t* zones){
+	if(zones->count == zones->capacity){
+		uint32_t capacity = zones->capacity ? zones->capacity * 2 : 8;
+		zone_t* grown = realloc(zones->zones, capacity * sizeof(zone_t));
+		if(grown == NULL) return NULL;
+
+		zones->zones = grown;
+		zones->capacity = capacity;
+	}
+
+	zone_t* zone = &zones->zones[zones->count];
+	memset(zone, 0, sizeof(zone_t));
+	return zone;
+}/*newZone*/
+
+
+/*! \brief Add a sector zone, set up the same way as a hardware alarm
+ *
+ *  \param zones set of zones
+ *
+ *  \param sector enabled, direction [degrees], width [degrees] around the direction and distance [cm] of the zone
+ *
+ *  \retval number of the zone
+ *  \retval -1 : the zone couldn't be allocated
+ *
+ *  \details A point enters the zone when it is more than 0 and at most distance away and within width around direction.
+ *           Directions are the same as for the stream: point i lies at i * 360 / pointTotal + forwardOffset degrees.
+ *           A disabled zone is never checked.
+ */
+int32_t sf40AddSectorZone(sf40Zones_t* zones, alarm_t sector){
+	zone_t* zone = newZone(zones);
+	if(zone == NULL) return -1;
+
+	double direction = sector.direction * M_PI / 180.0;
+	zone->enabled    = sector.enabled;
+	zone->polygon    = false;
+	zone->range      = sector.distance * 0.01f;
+	zone->directionX = (float)cos(direction);
+	zone->directionY = (float)sin(direction);
+	zone->spread     = (sector.width >= 360) ? -2.0f : (float)cos(sector.width * M_PI / 360.0);
+	return zones->count++;
+}/*sf40AddSectorZone*/
+
+
+/*! \brief Add a polygon zone
+ *
+ *  \param zones set of zones
+ *
+ *  \param x x [m] of every corner
+ *
+ *  \param y y [m] of every corner
+ *
+ *  \param corners number of corners, the last corner is connected to the first
+ *
+ *  \retval number of the zone
+ *  \retval -1 : the polygon has less than 3 corners or couldn't be allocated
+ *
+ *  \details x and y are the same as for sf40ScanToCartesian. The polygon doesn't have to be convex.
+ */
+int32_t sf40AddPolygonZone(sf40Zones_t* zones, const float* x, const float* y, uint16_t corners){
+	if(corners < 3) return -1;
+
+	edge_t* edges = malloc(corners * sizeof(edge_t));
+	if(edges == NULL) return -1;
+
+	zone_t* zone = newZone(zones);
+	if(zone == NULL){
+		free(edges);
+		return -1;
+	}
+
+	zone->enabled = true;
+	zone->polygon = true;
+	zone->edges = edges;
+	zone->box[0] = zone->box[1] = x[0];
+	zone->box[2] = zone->box[3] = y[0];
+
+	// horizontal sides are never crossed and are left out
+	for(uint16_t i = 0; i < corners; i++){
+		uint16_t next = (i + 1) % corners;
+		if(x[i] < zone->box[0]) zone->box[0] = x[i];
+		if(x[i] > zone->box[1]) zone->box[1] = x[i];
+		if(y[i] < zone->box[2]) zone->box[2] = y[i];
+		if(y[i] > zone->box[3]) zone->box[3] = y[i];
+		if(y[i] == y[next]) continue;
+
+		edges[zone->edgeCount].x     = x[i];
+		edges[zone->edgeCount].y     = y[i];
+		edges[zone->edgeCount].yEnd  = y[next];
+		edges[zone->edgeCount].slope = (x[next] - x[i]) / (y[next] - y[i]);
+		zone->edgeCount++;
+	}
+	return zones->count++;
+}/*sf40AddPolygonZone*/
+
+
+/*! \brief Number of zones in a set
+ */
+uint32_t sf40ZoneCount(const sf40Zones_t* zones){
+	return zones->count;
+}/*sf40ZoneCount*/
+
+
+/*! \brief Whether a zone is triggered
+ *
+ *  \param zones set of zones
+ *
+ *  \param zone number of the zone
+ *
+ *  \return true from the packet that entered the zone until it has been clear for a whole revolution
+ */
+bool sf40ZoneTriggered(const sf40Zones_t* zones, uint32_t zone){
+	return zone < zones->count && zones->zones[zone].triggered;
+}/*sf40ZoneTriggered*/
+
+
+/*! \brief Check every zone against the points that have been converted
+ *
+ *  \return number of zones with a point inside them
+ *
+ *  \details Points without a valid distance are made NaN first, so the kernels don't need the validity mask.
+ */
+static int32_t checkZones(sf40Zones_t* zones, uint16_t pointCount, uint16_t pointTotal, uint32_t* mask){
+	for(uint16_t i = 0; i < pointCount; i++){
+		if((zones->valid[i / 8] >> (i % 8)) & 1) continue;
+		zones->x[i] = NAN;
+		zones->y[i] = NAN;
+	}
+
+	if(mask != NULL) memset(mask, 0, SF40_ZONE_WORDS(zones->count) * sizeof(uint32_t));
+
+	zoneKernel_t sectorKernel  = SF40_KERNEL(sectorKernels);
+	zoneKernel_t polygonKernel = SF40_KERNEL(polygonKernels);
+
+	int32_t entered = 0;
+	uint32_t count = zones->count;
+	for(uint32_t i = 0; i < count; i++){
+		zone_t* zone = &zones->zones[i];
+		if(!zone->enabled) continue;
+
+		uint16_t inside = zone->polygon ? polygonKernel(zone, zones->x, zones->y, pointCount)
+										: sectorKernel(zone, zones->x, zones->y, pointCount);
+		if(inside){
+			entered++;
+			if(mask != NULL) mask[i / 32] |= (uint32_t)1 << (i % 32);
+
+			zone->clear = 0;
+			if(!zone->triggered){
+				zone->triggered = true;
+				if(zones->event != NULL) zones->event(zones, i, true, zones->user);
+			}
+		}
+		else{
+			zone->clear += pointCount;
+			if(zone->triggered && zone->clear >= pointTotal){
+				zone->triggered = false;
+				if(zones->event != NULL) zones->event(zones, i, false, zones->user);
+			}
+		}
+	}
+	return entered;
+}/*checkZones*/
+
+
+/*! \brief Check every zone against a packet from acquireStream
+ *
+ *  \param zones set of zones
+ *
+ *  \param view packet from acquireStream
+ *
+ *  \param mask location where bit i%32 of mask[i/32] is set for every zone i with a point in this packet,
+ *              must hold SF40_ZONE_WORDS(sf40ZoneCount(zones)) words, can be NULL
+ *
+ *  \retval number of zones with a point inside them
+ *  \retval -1 : the packet holds more than SF40_MAX_STREAM_POINTS points, or doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS
+ *
+ *  \details The event is called with triggered true for a zone that wasn't triggered and has a point inside it,
+ *           and with triggered false once a triggered zone has been clear for pointTotal points in a row.
+ *           The event is called from this function, it must not add zones.
+ */
+int32_t sf40CheckZonesView(sf40Zones_t* zones, const streamView_t* view, uint32_t* mask){
+	if(view->pointCount > SF40_MAX_STREAM_POINTS) return -1;
+	if(sf40ViewToCartesian(&zones->angles, view, zones->x, zones->y, zones->valid) < 0) return -1;
+
+	return checkZones(zones, view->pointCount, view->pointTotal, mask);
+}/*sf40CheckZonesView*/
+
+
+/*! \brief Check every zone against a packet from getStream
+ *
+ *  \param zones set of zones
+ *
+ *  \param packet packet from getStream
+ *
+ *  \param mask location for the zones with a point in this packet, see sf40CheckZonesView
+ *
+ *  \retval number of zones with a point inside them
+ *  \retval -1 : the packet holds more than SF40_MAX_STREAM_POINTS points, or doesn't fit in its revolution or in SF40_MAX_SCAN_POINTS
+ *
+ *  \details Same as sf40CheckZonesView.
+ */
+int32_t sf40CheckZonesPacket(sf40Zones_t* zones, const streamOutput_t* packet, uint32_t* mask){
+	if(sf40PacketToCartesian(&zones->angles, packet, zones->x, zones->y, zones->valid) < 0) return -1;
+
+	return checkZones(zones, packet->pointCount, packet->pointTotal, mask);
+}/*sf40CheckZonesPacket*/
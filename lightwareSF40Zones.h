@@ -0,0 +1,26 @@
+#ifndef _SF40_ZONES_H_
+#define _SF40_ZONES_H_
+
+    #include <stdint.h>
+    #include <stdbool.h>
+
+    #include "lightwareSF40.h"
+
+    #define SF40_ZONE_WORDS(zones) (((zones) + 31) / 32)     // uint32_t words needed for the mask of a number of zones
+
+    // Software alarm zones, any number of them, checked against every stream packet
+    typedef struct sf40Zones sf40Zones_t;
+
+    // Called when a zone is entered (triggered true) or has been clear for a whole revolution (triggered false)
+    typedef void (*sf40ZoneEvent_t)(sf40Zones_t* zones, uint32_t zone, bool triggered, void* user);
+
+    sf40Zones_t* sf40CreateZones(sf40ZoneEvent_t event, void* user);
+    void sf40FreeZones(sf40Zones_t* zones);
+    int32_t sf40AddSectorZone(sf40Zones_t* zones, alarm_t sector);
+    int32_t sf40AddPolygonZone(sf40Zones_t* zones, const float* x, const float* y, uint16_t corners);
+    uint32_t sf40ZoneCount(const sf40Zones_t* zones);
+    int32_t sf40CheckZonesView(sf40Zones_t* zones, const streamView_t* view, uint32_t* mask);
+    int32_t sf40CheckZonesPacket(sf40Zones_t* zones, const streamOutput_t* packet, uint32_t* mask);
+    bool sf40ZoneTriggered(const sf40Zones_t* zones, uint32_t zone);
+
+#endif
@@ -0,0 +1,221 @@
+/*!
+ *  \file    commandBench.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Round trip latency and cpu use of read commands, for the library's ppoll based wait and for
+ *           the usleep(10) spin loop readCommand used to do
+ *
+ *  \details A child process answers every request on a pseudo terminal as soon as it is complete,
+ *           so the measured time is the cost of sending, waiting and receiving.
+ */
+
+#define _GNU_SOURCE
+#include "lightwareSF40.h"
+#include "lightwareSF40CRC.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define ROUND_TRIPS 5000        // Commands measured per way of waiting
+
+// Latencies and cpu use of a way of waiting
+typedef struct{
+	double   cpu;               // User and system time of this process over all round trips [s]
+	uint32_t failed;            // Commands without a response
+	double   latency[ROUND_TRIPS];
+}result_t;
+
+
+/*! \brief Current time of the monotonic clock in seconds
+ */
+static double now(void){
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}/*now*/
+
+
+/*! \brief User and system time this process has used in seconds
+ */
+static double cpuTime(void){
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}/*cpuTime*/
+
+
+/*! \brief Answer every request with a response carrying 4 data bytes, until killed
+ */
+static void answerRequests(int master){
+	uint8_t request[MAX_RESPONSE_SIZE];
+	size_t have = 0;
+	while(true){
+		ssize_t received = read(master, &request[have], sizeof(request) - have);
+		if(received <= 0) _exit(EXIT_FAILURE);
+		have += received;
+
+		while(have >= 3){
+			if(request[0] != STARTBIT){
+				memmove(request, &request[1], --have);
+				continue;
+			}
+			size_t size = 5 + ((uint16_t)(request[1] | request[2] << 8) >> 6);
+			if(have < size) break;
+
+			uint8_t response[10] = { STARTBIT, (uint8_t)(5 << 6), (uint8_t)((5 << 6) >> 8), request[3], 1, 2, 3, 4 };
+			uint16_t crc = createCRC(response, 8);
+			response[8] = (uint8_t)crc;
+			response[9] = (uint8_t)(crc >> 8);
+			if(write(master, response, sizeof(response)) < 0) _exit(EXIT_FAILURE);
+
+			have -= size;
+			memmove(request, &request[size], have);
+		}
+	}
+}/*answerRequests*/
+
+
+/*! \brief Read one byte, blocking, the way readByte did
+ */
+static uint8_t readPortByte(int fd){
+	uint8_t byte = 0;
+	while(read(fd, &byte, 1) != 1);
+	return byte;
+}/*readPortByte*/
+
+
+/*! \brief Send a read request one byte per write and wait for the response in a usleep(10) loop,
+ *         the way readCommand did before it waited with ppoll
+ *
+ *  \return 0 when the response arrived within 100ms, -1 otherwise
+ */
+static int spinCommand(int fd, uint8_t command){
+	uint8_t packet[6] = { STARTBIT, (uint8_t)(1 << 6), 0, command };
+	uint16_t crc = createCRC(packet, 4);
+	packet[4] = (uint8_t)crc;
+	packet[5] = (uint8_t)(crc >> 8);
+	for(int i = 0; i < 6; i++){
+		if(write(fd, &packet[i], 1) != 1) return -1;
+	}
+
+	for(int cycles = 0; cycles <= 10000; cycles++){
+		usleep(10);
+
+		int waiting = 0;
+		if(ioctl(fd, FIONREAD, &waiting) < 0 || waiting == 0) continue;
+
+		uint8_t response[MAX_RESPONSE_SIZE];
+		response[0] = readPortByte(fd);
+		if(response[0] != STARTBIT) continue;
+		response[1] = readPortByte(fd);
+		response[2] = readPortByte(fd);
+		uint16_t length = (uint16_t)(response[1] | response[2] << 8) >> 6;
+		if(length < 1 || length > MAX_RESPONSE_SIZE - 5) continue;
+		for(int i = 0; i < length + 2; i++) response[i + 3] = readPortByte(fd);
+
+		if(response[3] == command) return 0;
+	}
+	return -1;
+}/*spinCommand*/
+
+
+/*! \brief Time round trips through the old spin loop
+ */
+static void measureSpin(const char* port, result_t* result){
+	int fd = open(port, O_RDWR | O_NOCTTY);
+	struct termios settings;
+	tcgetattr(fd, &settings);
+	cfmakeraw(&settings);
+	settings.c_cc[VMIN]  = 1;
+	settings.c_cc[VTIME] = 0;
+	tcsetattr(fd, TCSANOW, &settings);
+
+	double cpu = cpuTime();
+	for(int i = 0; i < ROUND_TRIPS; i++){
+		double sent = now();
+		if(spinCommand(fd, LIDAR_INCOMING_VOLTAGE) < 0) result->failed++;
+		result->latency[i] = now() - sent;
+	}
+	result->cpu = cpuTime() - cpu;
+	close(fd);
+}/*measureSpin*/
+
+
+/*! \brief Time round trips through sf40ReadCommand
+ */
+static void measureLibrary(const char* port, result_t* result){
+	sf40_t* lidar = sf40SetupLidar(port, LIDAR_921K6);
+	if(lidar == NULL){
+		result->failed = ROUND_TRIPS;
+		return;
+	}
+
+	uint8_t response[MAX_RESPONSE_SIZE];
+	double cpu = cpuTime();
+	for(int i = 0; i < ROUND_TRIPS; i++){
+		double sent = now();
+		if(sf40ReadCommand(lidar, LIDAR_INCOMING_VOLTAGE, response) < 0) result->failed++;
+		result->latency[i] = now() - sent;
+	}
+	result->cpu = cpuTime() - cpu;
+	sf40CloseLidar(lidar);
+}/*measureLibrary*/
+
+
+static int compareLatency(const void* a, const void* b){
+	double left = *(const double*)a, right = *(const double*)b;
+	return (left > right) - (left < right);
+}/*compareLatency*/
+
+
+/*! \brief Print the latency percentiles and the cpu time per round trip of a way of waiting
+ */
+static void report(const char* name, result_t* result){
+	qsort(result->latency, ROUND_TRIPS, sizeof(double), compareLatency);
+	printf("%-8s %10.1f %10.1f %10.1f %10.1f %7u\n", name,
+		   result->latency[ROUND_TRIPS / 2] * 1e6, result->latency[ROUND_TRIPS * 99 / 100] * 1e6,
+		   result->latency[ROUND_TRIPS - 1] * 1e6, result->cpu / ROUND_TRIPS * 1e6, result->failed);
+}/*report*/
+
+
+int main(void){
+	static result_t spin, library;
+
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if(master < 0 || grantpt(master) < 0 || unlockpt(master) < 0){
+		perror("pseudo terminal");
+		return EXIT_FAILURE;
+	}
+	const char* port = ptsname(master);
+	int keepOpen = open(port, O_RDWR | O_NOCTTY);
+
+	struct termios settings;
+	tcgetattr(master, &settings);
+	cfmakeraw(&settings);
+	tcsetattr(master, TCSANOW, &settings);
+
+	pid_t responder = fork();
+	if(responder == 0) answerRequests(master);
+
+	measureSpin(port, &spin);
+	measureLibrary(port, &library);
+
+	kill(responder, SIGKILL);
+	waitpid(responder, NULL, 0);
+
+	printf("%-8s %10s %10s %10s %10s %7s\n", "wait", "p50 [us]", "p99 [us]", "max [us]", "cpu [us]", "failed");
+	report("spin", &spin);
+	report("ppoll", &library);
+
+	close(keepOpen);
+	close(master);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,306 @@
+/*!
+ *  \file    commandTest.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Checks that responses are matched to their commands by command number, in whatever order
+ *           they arrive, that a command without a response fails after COMMAND_TIMEOUT_US, and that
+ *           stream packets arriving between responses end up in the stream queue. Also checks the read request
+ *           of every command number against one build with createCRC.
+ *
+ *  \details The test plays the lidar itself: it takes the requests the library sends over a memory transport
+ *           and decides which responses to send back and when.
+ */
+
+#include "memoryLidar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define COMMANDS 4      // Commands outstanding at the same time
+#define POINTS   20     // Points in every stream packet
+
+static const uint8_t commandNumbers[COMMANDS] = { LIDAR_INCOMING_VOLTAGE, LIDAR_TEMPRATURE, LIDAR_REVOLUTIONS, LIDAR_MOTOR_STATE };
+
+static int failures = 0;
+
+
+/*! \brief Report a value that differs from the expected one
+ */
+static void expect(const char* what, bool ok){
+	if(ok) return;
+	printf("FAIL %s\n", what);
+	failures++;
+}/*expect*/
+
+
+/*! \brief Current time of the monotonic clock in microseconds
+ */
+static uint64_t now(void){
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return (uint64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}/*now*/
+
+
+/*! \brief Payload the lidar answers to a command, different for every command and every round
+ */
+static void answerFor(uint8_t command, uint8_t round, uint8_t* data){
+	data[0] = command;
+	data[1] = round;
+	data[2] = (uint8_t)(command ^ 0x5A);
+	data[3] = (uint8_t)(round + 1);
+}/*answerFor*/
+
+
+/*! \brief Check that a command got the response that was sent for it
+ */
+static void expectResponse(const char* what, const lidarCommand_t* command, uint8_t round){
+	uint8_t data[4];
+	answerFor(command->command, round, data);
+	bool ok = command->result == 5 && command->response[3] == command->command && memcmp(&command->response[4], data, 4) == 0;
+	if(!ok) printf("FAIL %s: command %u has result %d\n", what, command->command, command->result);
+	failures += !ok;
+}/*expectResponse*/
+
+
+/*! \brief Take the next request and check that it is the read request of a command
+ */
+static void expectRequest(const char* what, sf40Transport_t* transport, uint8_t command){
+	uint8_t request[MAX_RESPONSE_SIZE];
+	uint16_t size = memoryRequest(transport, request);
+	bool ok = size == 6 && request[3] == command && !(request[1] & 1) &&
+			  createCRC(request, 4) == (uint16_t)(request[4] | request[5] << 8);
+	if(!ok) printf("FAIL %s: no read request for command %u\n", what, command);
+	failures += !ok;
+}/*expectRequest*/
+
+
+/*! \brief Send the responses of several outstanding commands in reverse order
+ */
+static void checkOutOfOrder(sf40_t* lidar, sf40Transport_t* transport){
+	static uint8_t responses[COMMANDS][MAX_RESPONSE_SIZE];
+	lidarCommand_t commands[COMMANDS];
+	memset(commands, 0, sizeof(commands));
+
+	for(int i = 0; i < COMMANDS; i++){
+		commands[i].command = commandNumbers[i];
+		commands[i].response = responses[i];
+		expect("submit", sf40SubmitCommand(lidar, &commands[i]) == 0);
+	}
+	for(int i = 0; i < COMMANDS; i++) expectRequest("out of order", transport, commandNumbers[i]);
+	expect("nothing else is send", memoryRequest(transport, responses[0]) == 0);
+
+	for(int i = COMMANDS - 1; i >= 0; i--){
+		uint8_t data[4];
+		answerFor(commandNumbers[i], 1, data);
+		memorySend(transport, commandNumbers[i], false, data, sizeof(data));
+	}
+	for(int i = 0; i < COMMANDS; i++){
+		sf40WaitCommand(lidar, &commands[i]);
+		expectResponse("out of order", &commands[i], 1);
+	}
+}/*checkOutOfOrder*/
+
+
+/*! \brief A second command with the same number can't be send while the first one waits
+ */
+static void checkDuplicate(sf40_t* lidar, sf40Transport_t* transport){
+	static uint8_t responses[2][MAX_RESPONSE_SIZE];
+	lidarCommand_t first = { .command = LIDAR_TEMPRATURE, .response = responses[0] };
+	lidarCommand_t second = { .command = LIDAR_TEMPRATURE, .response = responses[1] };
+
+	expect("duplicate: first is send", sf40SubmitCommand(lidar, &first) == 0);
+	expect("duplicate: second is refused", sf40SubmitCommand(lidar, &second) == -1);
+	expectRequest("duplicate", transport, LIDAR_TEMPRATURE);
+	expect("duplicate: only one request", memoryRequest(transport, responses[1]) == 0);
+
+	uint8_t data[4];
+	answerFor(LIDAR_TEMPRATURE, 2, data);
+	memorySend(transport, LIDAR_TEMPRATURE, false, data, sizeof(data));
+	sf40WaitCommand(lidar, &first);
+	expectResponse("duplicate", &first, 2);
+}/*checkDuplicate*/
+
+
+/*! \brief One of two commands is never answered
+ *
+ *  \details Waiting for it fails after COMMAND_TIMEOUT_US, the other one still gets its response.
+ *           A response that arrives after the timeout is dropped, and the next command with
+ *           the same number gets its own response.
+ */
+static void checkTimeout(sf40_t* lidar, sf40Transport_t* transport){
+	static uint8_t responses[2][MAX_RESPONSE_SIZE];
+	lidarCommand_t lost = { .command = LIDAR_INCOMING_VOLTAGE, .response = responses[0] };
+	lidarCommand_t answered = { .command = LIDAR_REVOLUTIONS, .response = responses[1] };
+
+	expect("timeout: submit", sf40SubmitCommand(lidar, &lost) == 0 && sf40SubmitCommand(lidar, &answered) == 0);
+	expectRequest("timeout", transport, LIDAR_INCOMING_VOLTAGE);
+	expectRequest("timeout", transport, LIDAR_REVOLUTIONS);
+
+	uint8_t data[4];
+	answerFor(LIDAR_REVOLUTIONS, 3, data);
+	memorySend(transport, LIDAR_REVOLUTIONS, false, data, sizeof(data));
+
+	uint64_t start = now();
+	int16_t result = sf40WaitCommand(lidar, &lost);
+	uint64_t waited = now() - start;
+	expect("timeout: lost command fails", result == -1 && lost.result == -1);
+	expect("timeout: after COMMAND_TIMEOUT_US", waited + 1000 >= COMMAND_TIMEOUT_US && waited < 5 * COMMAND_TIMEOUT_US);
+	expectResponse("timeout: other command", &answered, 3);
+
+	// the late response has nobody waiting for it anymore
+	memset(responses[0], 0, sizeof(responses[0]));
+	answerFor(LIDAR_INCOMING_VOLTAGE, 3, data);
+	memorySend(transport, LIDAR_INCOMING_VOLTAGE, false, data, sizeof(data));
+	expect("timeout: late response is dropped", sf40PollCommand(lidar, &lost) == -1 && responses[0][0] == 0);
+
+	lidarCommand_t again = { .command = LIDAR_INCOMING_VOLTAGE, .response = responses[0] };
+	expect("timeout: same command again", sf40SubmitCommand(lidar, &again) == 0);
+	expectRequest("timeout: same command again", transport, LIDAR_INCOMING_VOLTAGE);
+	answerFor(LIDAR_INCOMING_VOLTAGE, 4, data);
+	memorySend(transport, LIDAR_INCOMING_VOLTAGE, false, data, sizeof(data));
+	sf40WaitCommand(lidar, &again);
+	expectResponse("timeout: same command again", &again, 4);
+}/*checkTimeout*/
+
+
+static void countCompletion(lidarCommand_t* command, void* user){
+	(void)command;
+	(*(int*)user)++;
+}/*countCompletion*/
+
+
+/*! \brief Polling a command that is never answered returns 0 until its deadline, then -1 and its completion is called once
+ */
+static void checkPollTimeout(sf40_t* lidar, sf40Transport_t* transport){
+	static uint8_t response[MAX_RESPONSE_SIZE];
+	lidarCommand_t request;
+	int completions = 0;
+
+	expect("poll timeout: submit", sf40ReadAsync(lidar, &request, LIDAR_MOTOR_STATE, response, countCompletion, &completions) == 0);
+	expectRequest("poll timeout", transport, LIDAR_MOTOR_STATE);
+
+	uint64_t start = now();
+	int16_t result;
+	while((result = sf40PollCommand(lidar, &request)) == 0 && now() - start < 5 * COMMAND_TIMEOUT_US) usleep(1000);
+	uint64_t waited = now() - start;
+	expect("poll timeout: fails", result == -1);
+	expect("poll timeout: after COMMAND_TIMEOUT_US", waited + 1000 >= COMMAND_TIMEOUT_US);
+	sf40PollCommand(lidar, &request);
+	expect("poll timeout: completion is called once", completions == 1);
+}/*checkPollTimeout*/
+
+
+/*! \brief Read every command number and compare each request with one build here
+ *
+ *  \details The requests of the documented commands come from a table of hand typed checksums,
+ *           the others are build at runtime, both have to match.
+ */
+static void checkReadRequests(sf40_t* lidar, sf40Transport_t* transport){
+	static uint8_t response[MAX_RESPONSE_SIZE];
+	int wrong = 0;
+
+	for(int number = 0; number < 256; number++){
+		lidarCommand_t command = { .command = (uint8_t)number, .response = response };
+		expect("read requests: submit", sf40SubmitCommand(lidar, &command) == 0);
+
+		uint8_t request[MAX_RESPONSE_SIZE] = { 0 }, expected[6];
+		uint16_t size = memoryRequest(transport, request);
+		memoryPacket(expected, (uint8_t)number, false, NULL, 0);
+		if((size != 6 || memcmp(request, expected, 6) != 0) && wrong++ < 5){
+			printf("FAIL read request of command %d: %02X %02X %02X %02X %02X %02X\n", number,
+				   request[0], request[1], request[2], request[3], request[4], request[5]);
+		}
+
+		uint8_t data[4];
+		answerFor((uint8_t)number, 6, data);
+		memorySend(transport, (uint8_t)number, false, data, sizeof(data));
+		sf40WaitCommand(lidar, &command);
+		expectResponse("read requests", &command, 6);
+	}
+	failures += wrong;
+}/*checkReadRequests*/
+
+
+/*! \brief Send stream packets around the response of a command, all in one piece
+ *
+ *  \details The command gets its response, a response nobody asked for is dropped,
+ *           and the stream packets come out of getStream in the order they were send.
+ *           When reader is set the stream reader thread receives everything.
+ */
+static void checkDemux(bool reader){
+	const char* what = reader ? "demux with reader" : "demux";
+	sf40Transport_t* transport = sf40OpenMemory();
+	sf40_t* lidar = sf40OpenLidar(transport);
+	if(lidar == NULL || (reader && sf40StartStreamReader(lidar) < 0)){
+		expect(what, false);
+		return;
+	}
+
+	static uint8_t response[MAX_RESPONSE_SIZE];
+	lidarCommand_t command = { .command = LIDAR_TEMPRATURE, .response = response };
+	expect(what, sf40SubmitCommand(lidar, &command) == 0);
+	expectRequest(what, transport, LIDAR_TEMPRATURE);
+
+	static uint8_t bytes[8 * MAX_RESPONSE_SIZE];
+	size_t size = 0;
+	int16_t distances[POINTS];
+	uint8_t data[4];
+	for(uint16_t p = 0; p < 6; p++){
+		for(int i = 0; i < POINTS; i++) distances[i] = (int16_t)(p * 100 + i);
+		size += memoryStreamPacket(&bytes[size], 0, 0, 6 * POINTS, p * POINTS, POINTS, distances);
+		if(p == 2){
+			answerFor(LIDAR_TEMPRATURE, 5, data);
+			size += memoryPacket(&bytes[size], LIDAR_TEMPRATURE, false, data, sizeof(data));
+		}
+		if(p == 3){
+			answerFor(LIDAR_REVOLUTIONS, 5, data);
+			size += memoryPacket(&bytes[size], LIDAR_REVOLUTIONS, false, data, sizeof(data));
+		}
+	}
+	memoryPushCopy(transport, bytes, size);
+
+	sf40WaitCommand(lidar, &command);
+	expectResponse(what, &command, 5);
+
+	streamOutput_t output;
+	int received = 0;
+	uint64_t start = now();
+	while(received < 6 && now() - start < COMMAND_TIMEOUT_US){
+		int result = sf40GetStream(lidar, &output);
+		if(result == -3) continue;
+		bool ok = result == 0 && output.pointStartIndex == received * POINTS && output.pointCount == POINTS &&
+				  output.pointDistances[POINTS - 1] == received * 100 + POINTS - 1;
+		if(!ok) printf("FAIL %s: stream packet %d\n", what, received);
+		failures += !ok;
+		received++;
+	}
+	expect(what, received == 6 && sf40GetStream(lidar, &output) == -3);
+	sf40CloseLidar(lidar);
+}/*checkDemux*/
+
+
+int main(void){
+	sf40Transport_t* transport = sf40OpenMemory();
+	sf40_t* lidar = sf40OpenLidar(transport);
+	if(lidar == NULL){
+		printf("FAIL lidar couldn't be opened\n");
+		return EXIT_FAILURE;
+	}
+
+	checkOutOfOrder(lidar, transport);
+	checkDuplicate(lidar, transport);
+	checkTimeout(lidar, transport);
+	checkPollTimeout(lidar, transport);
+	checkReadRequests(lidar, transport);
+	sf40CloseLidar(lidar);
+
+	checkDemux(false);
+	checkDemux(true);
+
+	printf("commandTest: %d failure(s)\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
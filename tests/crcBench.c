@@ -0,0 +1,59 @@
+/*!
+ *  \file    crcBench.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Throughput of every checksum method, on command sized, stream sized and recorded stream sized buffers
+ */
+
+#include "lightwareSF40CRC.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_BYTES (256u << 20)    // Bytes checksummed per method and size
+
+static const char* methodNames[] = { "bitwise", "table", "slice8", "clmul" };
+
+
+/*! \brief Current time of the monotonic clock in nanoseconds
+ */
+static double nanoseconds(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}/*nanoseconds*/
+
+
+int main(void){
+	static const size_t sizes[] = { 6, 420, 1028, 64u << 20 };
+	uint8_t* data = malloc(sizes[3]);
+	if(data == NULL) return EXIT_FAILURE;
+	for(size_t i = 0; i < sizes[3]; i++) data[i] = (uint8_t)(i * 2654435761u >> 24);
+
+	printf("%-8s %10s %12s %10s\n", "method", "size", "bytes/ns", "ns/call");
+	for(sf40CrcMethod_t method = SF40_CRC_BITWISE; method <= SF40_CRC_CLMUL; method++){
+		if(sf40SetCrcMethod(method) < 0){
+			printf("%-8s not supported by this cpu\n", methodNames[method]);
+			continue;
+		}
+
+		for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+			size_t calls = BENCH_BYTES / sizes[s];
+			if(method == SF40_CRC_BITWISE) calls = calls / 8 + 1;
+
+			volatile uint16_t sink = 0;
+			double start = nanoseconds();
+			for(size_t call = 0; call < calls; call++) sink ^= sf40UpdateCRC(0, data, sizes[s]);
+			double elapsed = nanoseconds() - start;
+			(void)sink;
+
+			printf("%-8s %10zu %12.3f %10.1f\n", methodNames[method], sizes[s],
+				   (double)calls * sizes[s] / elapsed, elapsed / calls);
+		}
+	}
+
+	free(data);
+	return EXIT_SUCCESS;
+}
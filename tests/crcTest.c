@@ -0,0 +1,119 @@
+/*!
+ *  \file    crcTest.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Checks that every checksum method gives the same checksum as the bitwise one,
+ *           for every length, alignment and split into pieces
+ */
+
+#include "lightwareSF40CRC.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BUFFER_SIZE 4096    // Largest buffer that is checked
+#define ALIGNMENTS  16      // Offsets from an aligned address that are checked
+#define SPLITS      5000    // Buffers that are checked in random pieces
+
+static const char* methodNames[] = { "bitwise", "table", "slice8", "clmul" };
+
+static int failures = 0;
+
+
+/*! \brief Add one byte to a checksum the way the protocol documents it, one bit at a time
+ */
+static uint16_t referenceUpdate(uint16_t crc, uint8_t byte){
+	crc ^= (uint16_t)(byte << 8);
+	for(int bit = 0; bit < 8; bit++){
+		crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+	}
+	return crc;
+}/*referenceUpdate*/
+
+
+/*! \brief Checksum of a whole buffer with referenceUpdate
+ */
+static uint16_t referenceCRC(const uint8_t* data, size_t size){
+	uint16_t crc = 0;
+	for(size_t i = 0; i < size; i++) crc = referenceUpdate(crc, data[i]);
+	return crc;
+}/*referenceCRC*/
+
+
+/*! \brief Compare a checksum with the expected one and report a difference
+ */
+static void expect(sf40CrcMethod_t method, const char* what, size_t size, size_t offset, uint16_t got, uint16_t expected){
+	if(got == expected) return;
+
+	if(failures < 20){
+		printf("FAIL %-7s %s size %zu offset %zu: 0x%04X, expected 0x%04X\n",
+			   methodNames[method], what, size, offset, got, expected);
+	}
+	failures++;
+}/*expect*/
+
+
+/*! \brief Check one method against the reference
+ *
+ *  \details Every 1 and 2 byte input, every length up to BUFFER_SIZE at every alignment,
+ *           and random buffers fed in random pieces through sf40CrcUpdate.
+ */
+static void checkMethod(sf40CrcMethod_t method, const uint8_t* random){
+	uint8_t bytes[2];
+	for(uint32_t value = 0; value < 0x10000; value++){
+		bytes[0] = (uint8_t)value;
+		bytes[1] = (uint8_t)(value >> 8);
+		if(value < 0x100) expect(method, "byte", 1, 0, sf40UpdateCRC(0, bytes, 1), referenceCRC(bytes, 1));
+		expect(method, "pair", 2, 0, sf40UpdateCRC(0, bytes, 2), referenceCRC(bytes, 2));
+	}
+
+	for(size_t offset = 0; offset < ALIGNMENTS; offset++){
+		uint16_t expected = 0;
+		for(size_t size = 0; size <= BUFFER_SIZE; size++){
+			if(size > 0) expected = referenceUpdate(expected, random[offset + size - 1]);
+			expect(method, "buffer", size, offset, sf40UpdateCRC(0, &random[offset], size), expected);
+		}
+	}
+
+	for(int i = 0; i < SPLITS; i++){
+		size_t offset = rand() % ALIGNMENTS;
+		size_t size = rand() % (BUFFER_SIZE + 1);
+
+		sf40Crc_t state;
+		sf40CrcInit(&state);
+		for(size_t done = 0; done < size;){
+			size_t piece = 1 + rand() % (size - done < 300 ? size - done : 300);
+			sf40CrcUpdate(&state, &random[offset + done], piece);
+			done += piece;
+		}
+		expect(method, "pieces", size, offset, sf40CrcFinal(&state), referenceCRC(&random[offset], size));
+	}
+}/*checkMethod*/
+
+
+int main(void){
+	static uint8_t random[BUFFER_SIZE + ALIGNMENTS];
+	srand(40);
+	for(size_t i = 0; i < sizeof(random); i++) random[i] = (uint8_t)rand();
+
+	uint8_t packet[] = { 0xAA, 0x00, 0x00, 0x30 };
+	if(createCRC(packet, sizeof(packet)) != referenceCRC(packet, sizeof(packet))){
+		printf("FAIL createCRC differs from the reference\n");
+		failures++;
+	}
+
+	for(sf40CrcMethod_t method = SF40_CRC_BITWISE; method <= SF40_CRC_CLMUL; method++){
+		if(sf40SetCrcMethod(method) < 0){
+			printf("skip %s: not supported by this cpu\n", methodNames[method]);
+			continue;
+		}
+		int before = failures;
+		checkMethod(method, random);
+		printf("%s %s\n", failures == before ? "ok  " : "FAIL", methodNames[method]);
+	}
+
+	printf("crcTest: %d failure(s)\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+/*!
+ *  \file    decodeBench.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Time per packet of the distance conversion with every instruction set, next to the
+ *           per-point assembly getStream used to do, on 200 and 500 point packets
+ */
+
+#include "lightwareSF40Decode.h"
+#include "lightwareSF40Simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PACKETS 2000000     // Packets converted per measurement
+
+static const char* levelNames[] = { "scalar", "sse2", "avx2", "neon" };
+
+
+/*! \brief Current time of the monotonic clock in nanoseconds
+ */
+static double nanoseconds(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+}/*nanoseconds*/
+
+
+/*! \brief The loop getStream used before the vectorized conversion: assemble every distance from its bytes
+ */
+__attribute__((noinline))
+static void assembleLoop(const uint8_t* raw, uint16_t count, int16_t* distances){
+	for(uint16_t i = 0; i < count; i++){
+		distances[i] = (int16_t)(raw[(i*2)+1]<<8 | raw[i*2]);
+	}
+}/*assembleLoop*/
+
+
+int main(void){
+	static const uint16_t counts[] = { 200, 500 };
+	static uint8_t raw[1000];
+	static float meters[500];
+	static int32_t fixed[500];
+	static int16_t distances[500];
+	static uint8_t valid[SF40_VALID_BYTES(500)];
+	for(size_t i = 0; i < sizeof(raw); i++) raw[i] = (uint8_t)rand();
+
+	printf("%-16s %6s %10s\n", "conversion", "points", "ns/packet");
+	for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++){
+		double start = nanoseconds();
+		for(int packet = 0; packet < PACKETS; packet++){
+			assembleLoop(raw, counts[c], distances);
+			__asm__ volatile("" : : "r"(distances) : "memory");
+		}
+		printf("%-16s %6u %10.1f\n", "assemble (old)", counts[c], (nanoseconds() - start) / PACKETS);
+	}
+
+	sf40SimdLevel_t detected = sf40SimdLevel();
+	for(sf40SimdLevel_t level = SF40_SIMD_SCALAR; level < SF40_SIMD_LEVELS; level++){
+		if(sf40ForceSimdLevel(level) < 0) continue;
+
+		for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++){
+			volatile uint16_t sink = 0;
+			double start = nanoseconds();
+			for(int packet = 0; packet < PACKETS; packet++) sink += sf40DistancesToMeters(raw, counts[c], meters, valid);
+			printf("meters %-9s %6u %10.1f\n", levelNames[level], counts[c], (nanoseconds() - start) / PACKETS);
+
+			start = nanoseconds();
+			for(int packet = 0; packet < PACKETS; packet++) sink += sf40DistancesToFixed(raw, counts[c], 10, fixed, valid);
+			printf("fixed  %-9s %6u %10.1f\n", levelNames[level], counts[c], (nanoseconds() - start) / PACKETS);
+			(void)sink;
+		}
+	}
+	sf40ForceSimdLevel(detected);
+	return EXIT_SUCCESS;
+}
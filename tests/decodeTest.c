@@ -0,0 +1,109 @@
+/*!
+ *  \file    decodeTest.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Checks that the scalar, SSE2, AVX2 and NEON distance conversions give the same meters,
+ *           fixed point values and validity mask, for every packet size and alignment
+ */
+
+#include "lightwareSF40Decode.h"
+#include "lightwareSF40Simd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_POINTS  520     // Largest number of points that is checked, a bit more than a full size packet
+#define ALIGNMENTS  32      // Byte offsets of the raw distances that are checked
+#define SCALES      6       // Fixed point scales checked for every size
+
+static const char* levelNames[] = { "scalar", "sse2", "avx2", "neon" };
+
+static int failures = 0;
+
+
+/*! \brief Report a difference
+ */
+static void fail(sf40SimdLevel_t level, const char* what, uint16_t count, size_t offset, uint16_t index){
+	if(failures < 20) printf("FAIL %-6s %s count %u offset %zu point %u\n", levelNames[level], what, count, offset, index);
+	failures++;
+}/*fail*/
+
+
+/*! \brief Distance of point i, assembled from its two bytes
+ */
+static int16_t distanceAt(const uint8_t* raw, uint16_t i){
+	return (int16_t)(raw[(i*2)+1]<<8 | raw[i*2]);
+}/*distanceAt*/
+
+
+/*! \brief Check the validity mask and the number of valid points
+ */
+static void checkValid(sf40SimdLevel_t level, const char* what, const uint8_t* raw, uint16_t count, size_t offset,
+					   const uint8_t* valid, uint16_t valids){
+	uint16_t expected = 0;
+	for(uint16_t i = 0; i < count; i++){
+		bool ok = distanceAt(raw, i) >= 0;
+		expected += ok;
+		if((bool)((valid[i / 8] >> (i % 8)) & 1) != ok) fail(level, what, count, offset, i);
+	}
+	if(valids != expected) fail(level, what, count, offset, count);
+}/*checkValid*/
+
+
+/*! \brief Check both conversions of one instruction set for one size and alignment
+ */
+static void checkConversion(sf40SimdLevel_t level, const uint8_t* raw, uint16_t count, size_t offset){
+	static const int16_t scales[SCALES] = { 1, 10, 100, -7, INT16_MAX, INT16_MIN };
+	float meters[MAX_POINTS];
+	int32_t fixed[MAX_POINTS];
+	uint8_t valid[SF40_VALID_BYTES(MAX_POINTS)];
+
+	memset(valid, 0xA5, sizeof(valid));
+	uint16_t valids = sf40DistancesToMeters(raw, count, meters, valid);
+	checkValid(level, "meters mask", raw, count, offset, valid, valids);
+	for(uint16_t i = 0; i < count; i++){
+		if(meters[i] != distanceAt(raw, i) * 0.01f) fail(level, "meters", count, offset, i);
+	}
+	if(sf40DistancesToMeters(raw, count, meters, NULL) != valids) fail(level, "meters without mask", count, offset, count);
+
+	for(int s = 0; s < SCALES; s++){
+		memset(valid, 0x5A, sizeof(valid));
+		valids = sf40DistancesToFixed(raw, count, scales[s], fixed, valid);
+		checkValid(level, "fixed mask", raw, count, offset, valid, valids);
+		for(uint16_t i = 0; i < count; i++){
+			if(fixed[i] != (int32_t)distanceAt(raw, i) * scales[s]) fail(level, "fixed", count, offset, i);
+		}
+	}
+}/*checkConversion*/
+
+
+int main(void){
+	static uint8_t random[MAX_POINTS * 2 + ALIGNMENTS];
+	srand(15);
+	for(size_t i = 0; i < sizeof(random); i++) random[i] = (uint8_t)rand();
+
+	// half the distances negative, and the extremes of int16_t somewhere in the buffer
+	random[10] = 0x00; random[11] = 0x80;
+	random[20] = 0xFF; random[21] = 0x7F;
+	random[30] = 0xFF; random[31] = 0xFF;
+	random[40] = 0x00; random[41] = 0x00;
+
+	sf40SimdLevel_t detected = sf40SimdLevel();
+	for(sf40SimdLevel_t level = SF40_SIMD_SCALAR; level < SF40_SIMD_LEVELS; level++){
+		if(sf40ForceSimdLevel(level) < 0){
+			printf("skip %s: not supported by this cpu or build\n", levelNames[level]);
+			continue;
+		}
+		int before = failures;
+		for(size_t offset = 0; offset < ALIGNMENTS; offset++){
+			for(uint16_t count = 0; count <= MAX_POINTS; count++) checkConversion(level, &random[offset], count, offset);
+		}
+		printf("%s %s\n", failures == before ? "ok  " : "FAIL", levelNames[level]);
+	}
+	sf40ForceSimdLevel(detected);
+
+	printf("decodeTest: %d failure(s)\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+/*!
+ *  \file    memoryLidar.h
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Lidar played by the tests themselves over a memory transport
+ *
+ *  \details Packets for the library are built with its own checksum and handed over with sf40MemoryPush,
+ *           the requests it sends are taken back with sf40MemoryPull. A test either answers the requests
+ *           itself, or starts memoryLidarStart to answer them from a thread while it calls blocking functions.
+ */
+
+#ifndef _MEMORY_LIDAR_H_
+#define _MEMORY_LIDAR_H_
+
+    #include "lightwareSF40.h"
+    #include "lightwareSF40CRC.h"
+    #include "lightwareSF40Transport.h"
+    #include <pthread.h>
+    #include <stdatomic.h>
+    #include <stdlib.h>
+
+    #define MEMORY_ANSWER_SIZE 32   // Largest payload the answering thread sends for one command
+
+    // Lidar that answers every request from a thread
+    typedef struct{
+        sf40Transport_t* transport;
+        sf40_t*          lidar;
+        pthread_t        thread;
+        atomic_bool      running;
+        uint8_t          answer[256][MEMORY_ANSWER_SIZE];   // Payload sent back for a read of each command
+        uint8_t          answerSize[256];                   // Bytes in answer, a command with 0 isn't answered
+        atomic_int       lastCommand;                       // Command number of the last request, -1 before the first
+        atomic_bool      lastWrite;                         // The last request was a write
+    }memoryLidar_t;
+
+
+    /*! \brief Build a packet the way the lidar sends it
+     *
+     *  \return number of bytes in packet
+     */
+    static inline uint16_t memoryPacket(uint8_t* packet, uint8_t command, bool write, const uint8_t* data, uint16_t size){
+        uint16_t flags = (uint16_t)((1 + size) << 6) | write;
+        packet[0] = STARTBIT;
+        packet[1] = (uint8_t)flags;
+        packet[2] = (uint8_t)(flags >> 8);
+        packet[3] = command;
+        if(size > 0) memcpy(&packet[4], data, size);
+
+        uint16_t crc = createCRC(packet, 4 + size);
+        packet[4 + size] = (uint8_t)crc;
+        packet[5 + size] = (uint8_t)(crc >> 8);
+        return 6 + size;
+    }/*memoryPacket*/
+
+
+    /*! \brief Build a distance output packet
+     *
+     *  \return number of bytes in packet
+     */
+    static inline uint16_t memoryStreamPacket(uint8_t* packet, uint8_t alarms, uint8_t revolution, uint16_t total,
+                                              uint16_t start, uint16_t count, const int16_t* distances){
+        uint8_t data[14 + 2 * SF40_MAX_STREAM_POINTS] = { 0 };
+        data[0]  = alarms;
+        data[7]  = revolution;
+        data[8]  = (uint8_t)total;
+        data[9]  = (uint8_t)(total >> 8);
+        data[10] = (uint8_t)count;
+        data[11] = (uint8_t)(count >> 8);
+        data[12] = (uint8_t)start;
+        data[13] = (uint8_t)(start >> 8);
+        for(uint16_t i = 0; i < count; i++){
+            data[14 + i * 2] = (uint8_t)distances[i];
+            data[15 + i * 2] = (uint8_t)((uint16_t)distances[i] >> 8);
+        }
+        return memoryPacket(packet, LIDAR_DISTANCE_OUTPUT, false, data, 14 + 2 * count);
+    }/*memoryStreamPacket*/
+
+
+    static inline void memoryFree(void* user, const uint8_t* data){
+        (void)user;
+        free((void*)data);
+    }/*memoryFree*/
+
+
+    /*! \brief Hand a copy of bytes to the library, waiting while the transport is full
+     *
+     *  \retval  0 : the bytes are handed over
+     *  \retval -1 : no memory for the copy
+     */
+    static inline int memoryPushCopy(sf40Transport_t* transport, const uint8_t* data, size_t size){
+        uint8_t* copy = malloc(size);
+        if(copy == NULL) return -1;
+        memcpy(copy, data, size);
+        while(sf40MemoryPush(transport, copy, size, memoryFree, NULL) < 0) usleep(10);
+        return 0;
+    }/*memoryPushCopy*/
+
+
+    /*! \brief Send a response packet to the library
+     */
+    static inline int memorySend(sf40Transport_t* transport, uint8_t command, bool write, const uint8_t* data, uint16_t size){
+        uint8_t packet[MAX_RESPONSE_SIZE];
+        return memoryPushCopy(transport, packet, memoryPacket(packet, command, write, data, size));
+    }/*memorySend*/
+
+
+    /*! \brief Take the next request the library has sent
+     *
+     *  \return number of bytes in request, 0 when there is none
+     *
+     *  \details The library writes every packet at once, so a header is always followed by the rest.
+     */
+    static inline uint16_t memoryRequest(sf40Transport_t* transport, uint8_t* request){
+        if(sf40MemoryPull(transport, request, 3) < 3) return 0;
+        uint16_t size = 5 + ((uint16_t)(request[1] | request[2] << 8) >> 6);
+        if(size > MAX_RESPONSE_SIZE) return 0;
+        return 3 + sf40MemoryPull(transport, &request[3], size - 3);
+    }/*memoryRequest*/
+
+
+    /*! \brief Answer every request until memoryLidarStop, a write gets its own payload back
+     */
+    static inline void* memoryAnswer(void* argument){
+        memoryLidar_t* sim = argument;
+        uint8_t request[MAX_RESPONSE_SIZE];
+
+        while(atomic_load(&sim->running)){
+            uint16_t size = memoryRequest(sim->transport, request);
+            if(size == 0){
+                usleep(20);
+                continue;
+            }
+
+            uint8_t command = request[3];
+            bool write = request[1] & 1;
+            atomic_store(&sim->lastWrite, write);
+            atomic_store(&sim->lastCommand, command);
+            if(write) memorySend(sim->transport, command, true, &request[4], size - 6);
+            else if(sim->answerSize[command] > 0) memorySend(sim->transport, command, false, sim->answer[command], sim->answerSize[command]);
+        }
+        return NULL;
+    }/*memoryAnswer*/
+
+
+    /*! \brief Open a lidar over a memory transport and start answering its requests
+     *
+     *  \return handle of the lidar, NULL when it couldn't be opened
+     *
+     *  \details Fill answer and answerSize before starting, the thread only reads them.
+     */
+    static inline sf40_t* memoryLidarStart(memoryLidar_t* sim){
+        sim->transport = sf40OpenMemory();
+        sim->lidar = sf40OpenLidar(sim->transport);
+        if(sim->lidar == NULL) return NULL;
+
+        atomic_store(&sim->lastCommand, -1);
+        atomic_store(&sim->running, true);
+        if(pthread_create(&sim->thread, NULL, memoryAnswer, sim) != 0){
+            sf40CloseLidar(sim->lidar);
+            return NULL;
+        }
+        return sim->lidar;
+    }/*memoryLidarStart*/
+
+
+    /*! \brief Stop answering and close the lidar together with its transport
+     */
+    static inline void memoryLidarStop(memoryLidar_t* sim){
+        atomic_store(&sim->running, false);
+        pthread_join(sim->thread, NULL);
+        sf40CloseLidar(sim->lidar);
+    }/*memoryLidarStop*/
+
+#endif
@@ -0,0 +1,182 @@
+/*!
+ *  \file    parserTest.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Checks that the packet parser finds every good packet back after a broken one,
+ *           however the bytes are split up when they arrive
+ *
+ *  \details Every case hands a byte stream to a lidar over a memory transport and compares the stream
+ *           packets getStream returns, and the rejected packets in the stream stats, with the expected ones.
+ */
+
+#include "memoryLidar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STREAM_SIZE 8192        // Largest byte stream of a case
+#define POINTS      40          // Points in every good packet
+
+static int failures = 0;
+
+// Byte stream of a case and the packets that should come out of it
+typedef struct{
+	const char* name;
+	uint8_t     bytes[STREAM_SIZE];
+	size_t      size;
+	uint16_t    expected[64];       // pointStartIndex of every good packet, in order
+	int         packets;
+	uint32_t    crcErrors;
+	uint32_t    lengthErrors;
+}stream_t;
+
+
+/*! \brief Add a good stream packet, its start index tells it apart from the others
+ */
+static void addPacket(stream_t* stream, uint16_t start){
+	int16_t distances[POINTS];
+	for(int i = 0; i < POINTS; i++) distances[i] = (int16_t)(start + i);
+
+	stream->size += memoryStreamPacket(&stream->bytes[stream->size], 0, 0, 4000, start, POINTS, distances);
+	stream->expected[stream->packets++] = start;
+}/*addPacket*/
+
+
+/*! \brief Add raw bytes that are not a good packet
+ */
+static void addBytes(stream_t* stream, const uint8_t* bytes, size_t size){
+	memcpy(&stream->bytes[stream->size], bytes, size);
+	stream->size += size;
+}/*addBytes*/
+
+
+/*! \brief Add a stream packet with one bit of its payload flipped, so its checksum doesn't match
+ */
+static void addCorrupted(stream_t* stream, uint16_t start){
+	int16_t distances[POINTS] = { 0 };
+	uint16_t size = memoryStreamPacket(&stream->bytes[stream->size], 0, 0, 4000, start, POINTS, distances);
+	stream->bytes[stream->size + 20] ^= 0x10;
+	stream->size += size;
+	stream->crcErrors++;
+}/*addCorrupted*/
+
+
+/*! \brief Hand the stream to a new lidar in pieces of the given size and check what comes out
+ *
+ *  \details The packets are taken as soon as each piece has arrived, so a packet is also parsed
+ *           while only part of it is there.
+ */
+static void check(const stream_t* stream, size_t piece){
+	sf40Transport_t* transport = sf40OpenMemory();
+	sf40_t* lidar = sf40OpenLidar(transport);
+	if(lidar == NULL){
+		printf("FAIL %s: lidar couldn't be opened\n", stream->name);
+		failures++;
+		return;
+	}
+
+	int received = 0;
+	bool ok = true;
+	streamOutput_t output;
+	for(size_t done = 0; done < stream->size; done += piece){
+		size_t size = stream->size - done < piece ? stream->size - done : piece;
+		memoryPushCopy(transport, &stream->bytes[done], size);
+
+		int result;
+		while((result = sf40GetStream(lidar, &output)) == 0){
+			if(received >= stream->packets || output.pointStartIndex != stream->expected[received]) ok = false;
+			if(output.pointCount != POINTS || output.pointDistances[POINTS - 1] != output.pointStartIndex + POINTS - 1) ok = false;
+			received++;
+		}
+		if(result != -3) ok = false;
+	}
+
+	streamStats_t stats;
+	sf40GetStreamStats(lidar, &stats);
+	if(!ok || received != stream->packets || stats.crcErrors != stream->crcErrors || stats.lengthErrors != stream->lengthErrors){
+		printf("FAIL %s in pieces of %zu: %d of %d packets, %u checksum and %u length errors, expected %u and %u\n",
+			   stream->name, piece, received, stream->packets, stats.crcErrors, stats.lengthErrors,
+			   stream->crcErrors, stream->lengthErrors);
+		failures++;
+	}
+	sf40CloseLidar(lidar);
+}/*check*/
+
+
+/*! \brief Check a stream whole, byte by byte and in odd sized pieces
+ */
+static void checkSplits(const stream_t* stream){
+	static const size_t pieces[] = { 1, 2, 3, 7, 64, 101, STREAM_SIZE };
+	int before = failures;
+	for(size_t p = 0; p < sizeof(pieces) / sizeof(pieces[0]); p++) check(stream, pieces[p]);
+	printf("%s %s\n", failures == before ? "ok  " : "FAIL", stream->name);
+}/*checkSplits*/
+
+
+int main(void){
+	static stream_t stream;
+
+	// packets back to back, nothing to resync
+	memset(&stream, 0, sizeof(stream));
+	stream.name = "clean";
+	for(uint16_t p = 0; p < 8; p++) addPacket(&stream, p * POINTS);
+	checkSplits(&stream);
+
+	// noise before and between the packets, with start bytes in it
+	memset(&stream, 0, sizeof(stream));
+	stream.name = "noise";
+	const uint8_t noise[] = { 0x00, 0x13, 0x55, 0xFF, 0x01 };
+	addBytes(&stream, noise, sizeof(noise));
+	addPacket(&stream, 0);
+	addBytes(&stream, noise, sizeof(noise));
+	addPacket(&stream, 40);
+	checkSplits(&stream);
+
+	// a packet with a bad checksum between good ones
+	memset(&stream, 0, sizeof(stream));
+	stream.name = "bad checksum";
+	addPacket(&stream, 0);
+	addCorrupted(&stream, 40);
+	addPacket(&stream, 80);
+	addCorrupted(&stream, 120);
+	addCorrupted(&stream, 160);
+	addPacket(&stream, 200);
+	checkSplits(&stream);
+
+	// a header that was cut off, the start byte of the next packet is taken as the high byte of its length,
+	// the parser waits for that many bytes and then finds the packets back inside them
+	memset(&stream, 0, sizeof(stream));
+	stream.name = "truncated header";
+	const uint8_t truncated[] = { STARTBIT, (uint8_t)((15 + 2 * POINTS) << 6) };
+	addPacket(&stream, 0);
+	addBytes(&stream, truncated, sizeof(truncated));
+	for(uint16_t p = 1; p < 12; p++) addPacket(&stream, p * POINTS);
+	stream.crcErrors = 1;
+	checkSplits(&stream);
+
+	// start bytes followed by a zero length, once with the other flag bits set
+	memset(&stream, 0, sizeof(stream));
+	stream.name = "bad length";
+	const uint8_t empty[] = { STARTBIT, 0x00, 0x00 };
+	const uint8_t flagsOnly[] = { STARTBIT, 0x3F, 0x00 };
+	addBytes(&stream, empty, sizeof(empty));
+	addPacket(&stream, 0);
+	addBytes(&stream, flagsOnly, sizeof(flagsOnly));
+	addPacket(&stream, 40);
+	stream.lengthErrors = 2;
+	checkSplits(&stream);
+
+	// a start byte with a plausible length in front of a packet, the parser waits for a packet that isn't there
+	memset(&stream, 0, sizeof(stream));
+	stream.name = "false start";
+	const uint8_t falseStart[] = { STARTBIT, (uint8_t)(100 << 6), (uint8_t)((100 << 6) >> 8) };
+	addBytes(&stream, falseStart, sizeof(falseStart));
+	for(uint16_t p = 0; p < 4; p++) addPacket(&stream, p * POINTS);
+	stream.crcErrors = 1;
+	checkSplits(&stream);
+
+	printf("parserTest: %d failure(s)\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
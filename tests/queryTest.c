@@ -0,0 +1,148 @@
+/*!
+ *  \file    queryTest.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Checks sf40ScanDistances against a brute force pass over every point of the scan,
+ *           for views that pass 0 degrees, views wider than the scan and batches that are put together from blocks
+ *
+ *  \details The reference decides for every point on its own whether it lies in a view, with exact integer angles,
+ *           so it doesn't share the range arithmetic of the library.
+ */
+
+#include "lightwareSF40Query.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VIEWS 200       // Views answered in one call, more than one batch
+
+static int failures = 0;
+
+
+/*! \brief Fill a scan with random distances, some of them negative, close or not received
+ */
+static void randomScan(sf40Scan_t* scan, uint16_t pointTotal, int16_t forwardOffset){
+	memset(scan, 0, sizeof(*scan));
+	scan->pointTotal = pointTotal;
+	scan->forwardOffset = forwardOffset;
+	for(uint16_t i = 0; i < pointTotal; i++){
+		if(rand() % 3) scan->distances[i] = (int16_t)(rand() % 5000);
+		else scan->distances[i] = (int16_t)(rand() % 2 ? -1 : rand() % 50);
+		if(rand() % 10) scan->coverage[i >> 3] |= (uint8_t)(1 << (i & 7));
+	}
+}/*randomScan*/
+
+
+/*! \brief Answer a view by looking at every point of the scan
+ *
+ *  \details Angles are counted in 1 / (2 * pointTotal) degrees, so point i lies at exactly 720 * i + 2 * pointTotal * forwardOffset.
+ *           The position of a point is how far it lies past the start of the view, of equal distances the lowest position wins.
+ */
+static void bruteForce(const sf40Scan_t* scan, const writeDistance_t* view, readDistance_t* result){
+	int64_t total = scan->pointTotal;
+	int64_t turn  = 720 * total;
+	int64_t from  = (2 * (int64_t)view->direction - view->width) * total;
+	int16_t minimum = view->minimumDistance > 0 ? view->minimumDistance : 0;
+
+	int64_t sum = 0;
+	int32_t count = 0;
+	int16_t closest = INT16_MAX, furthest = -1;
+	int64_t closestPosition = INT64_MAX;
+	uint16_t closestIndex = 0;
+
+	for(uint16_t i = 0; i < total; i++){
+		int64_t position = (view->width >= 360) ? i : (((720 * i + 2 * total * scan->forwardOffset - from) % turn) + turn) % turn;
+		if(view->width < 360 && position > 2 * (int64_t)view->width * total) continue;
+		if(!sf40ScanCovered(scan, i) || scan->distances[i] < minimum) continue;
+
+		int16_t distance = scan->distances[i];
+		sum += distance;
+		count++;
+		if(distance < closest || (distance == closest && position < closestPosition)){
+			closest = distance;
+			closestPosition = position;
+			closestIndex = i;
+		}
+		if(distance > furthest) furthest = distance;
+	}
+
+	if(count == 0){
+		*result = (readDistance_t){ .averageDistance = -1, .closestDistance = -1, .furthestDistance = -1, .angle = 0 };
+		return;
+	}
+	int32_t angle = (int32_t)(closestIndex * 3600 / total) + scan->forwardOffset * 10;
+	result->averageDistance  = (int16_t)(sum / count);
+	result->closestDistance  = closest;
+	result->furthestDistance = furthest;
+	result->angle            = (int16_t)(((angle % 3600) + 3600) % 3600);
+}/*bruteForce*/
+
+
+/*! \brief Answer views in one call and compare every answer with the brute force one
+ */
+static void check(const char* what, const sf40Scan_t* scan, const writeDistance_t* views, uint16_t count){
+	static readDistance_t results[VIEWS];
+	if(sf40ScanDistances(scan, views, results, count) != 0){
+		printf("FAIL %s: no answer\n", what);
+		failures++;
+		return;
+	}
+
+	for(uint16_t i = 0; i < count; i++){
+		readDistance_t expected;
+		bruteForce(scan, &views[i], &expected);
+		const readDistance_t* found = &results[i];
+		if(found->averageDistance != expected.averageDistance || found->closestDistance != expected.closestDistance ||
+		   found->furthestDistance != expected.furthestDistance || found->angle != expected.angle){
+			printf("FAIL %s: %u points offset %d, view %d+-%d from %d: %d %d %d %d, expected %d %d %d %d\n",
+				   what, scan->pointTotal, scan->forwardOffset, views[i].direction, views[i].width / 2, views[i].minimumDistance,
+				   found->averageDistance, found->closestDistance, found->furthestDistance, found->angle,
+				   expected.averageDistance, expected.closestDistance, expected.furthestDistance, expected.angle);
+			failures++;
+			return;
+		}
+	}
+}/*check*/
+
+
+int main(void){
+	static sf40Scan_t scan;
+	static writeDistance_t views[VIEWS];
+	static const uint16_t totals[] = { 1, 17, 504, 1000, 1001, 8192 };
+	static const int16_t offsets[] = { 0, -20, 37, 359 };
+	srand(1);
+
+	for(size_t t = 0; t < sizeof(totals) / sizeof(totals[0]); t++){
+		for(size_t o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++){
+			randomScan(&scan, totals[t], offsets[o]);
+
+			// any direction and width, a few views at a time so the points of every view are looked at
+			for(int round = 0; round < 50; round++){
+				for(int i = 0; i < 8; i++){
+					views[i] = (writeDistance_t){ .direction = (int16_t)(rand() % 800 - 400), .width = (int16_t)(rand() % 400),
+												  .minimumDistance = (int16_t)(rand() % 100 - 10) };
+				}
+				check("random views", &scan, views, 8);
+			}
+
+			// windows across 0 degrees, on the edge of it and right next to it
+			static const int16_t across[][2] = { {0, 90}, {0, 2}, {1, 2}, {-1, 2}, {359, 10}, {180, 359}, {0, 360}, {10, 720} };
+			for(size_t i = 0; i < sizeof(across) / sizeof(across[0]); i++){
+				views[i] = (writeDistance_t){ .direction = across[i][0], .width = across[i][1], .minimumDistance = 0 };
+			}
+			check("across 0 degrees", &scan, views, sizeof(across) / sizeof(across[0]));
+
+			// many wide views with the same minimum, so the scan is summarised in blocks, over more than one batch
+			for(int i = 0; i < VIEWS; i++){
+				views[i] = (writeDistance_t){ .direction = (int16_t)(i * 7), .width = (int16_t)(60 + i % 5 * 70),
+											  .minimumDistance = (int16_t)(i % 3 ? 20 : 0) };
+			}
+			check("batch", &scan, views, VIEWS);
+		}
+	}
+
+	printf("queryTest: %d failure(s)\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/*!
+ *  \file    responseTest.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Checks the decoders on known response packets, and that every getter asks for its own command
+ */
+
+#include "memoryLidar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+
+/*! \brief Report a value that differs from the expected one
+ */
+static void expect(const char* what, bool ok){
+	if(ok) return;
+	printf("FAIL %s\n", what);
+	failures++;
+}/*expect*/
+
+
+/*! \brief Response packet of a read with a 32 bit little endian value
+ */
+static void response32(uint8_t* packet, uint8_t command, uint32_t value){
+	uint8_t data[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+	memoryPacket(packet, command, false, data, sizeof(data));
+}/*response32*/
+
+
+/*! \brief Decode packets of which every byte of the value is known
+ */
+static void checkDecoders(void){
+	uint8_t packet[32];
+
+	response32(packet, LIDAR_INCOMING_VOLTAGE, 0x00000B6E);
+	expect("voltage", sf40DecodeVoltage(packet) == (float)(LIDAR_VOLTAGE(0x0B6E)));
+
+	response32(packet, LIDAR_TEMPRATURE, 2731);
+	expect("temperature", sf40DecodeTemperature(packet) == 27.31f);
+	response32(packet, LIDAR_TEMPRATURE, (uint32_t)-550);
+	expect("temperature below zero", sf40DecodeTemperature(packet) == -5.5f);
+
+	response32(packet, LIDAR_REVOLUTIONS, 0x12345678);
+	expect("revolutions", sf40DecodeRevolutions(packet) == 0x12345678);
+	response32(packet, LIDAR_REVOLUTIONS, 0xFFFFFFFF);
+	expect("revolutions before the wrap", sf40DecodeRevolutions(packet) == 0xFFFFFFFF);
+
+	uint8_t motor[2] = { 0xE0, 0x2E };
+	memoryPacket(packet, LIDAR_MOTOR_VOLTAGE, false, motor, sizeof(motor));
+	expect("motor voltage", sf40DecodeMotorVoltage(packet) == 12.0f);
+
+	uint8_t offset[2] = { 0xA6, 0xFF };
+	memoryPacket(packet, LIDAR_FORWARD_OFFSET, false, offset, sizeof(offset));
+	expect("offset", sf40DecodeOffset(packet) == -90);
+
+	uint8_t token[2] = { 0x34, 0x12 };
+	memoryPacket(packet, LIDAR_TOKEN, false, token, sizeof(token));
+	expect("token", sf40DecodeToken(packet) == 0x1234);
+
+	uint8_t distance[12] = { 0xF4, 0x01, 0x64, 0x00, 0xE8, 0x03, 0x08, 0x07, 0x45, 0x23, 0x01, 0x80 };
+	memoryPacket(packet, LIDAR_DISTANCE, false, distance, sizeof(distance));
+	readDistance_t decoded;
+	sf40DecodeDistance(packet, &decoded);
+	expect("distance average", decoded.averageDistance == 500);
+	expect("distance closest", decoded.closestDistance == 100);
+	expect("distance furthest", decoded.furthestDistance == 1000);
+	expect("distance angle", decoded.angle == 1800);
+	expect("distance calculation time", decoded.calculationTime == 0x80012345);
+}/*checkDecoders*/
+
+
+/*! \brief Call the getters on a lidar that only answers the command each one should ask for
+ */
+static void checkGetters(void){
+	static memoryLidar_t sim;
+
+	const uint8_t revolutions[4] = { 0x78, 0x56, 0x34, 0x12 };
+	const uint8_t offset[2] = { 0x2D, 0x00 };
+	const uint8_t temperature[4] = { 0x9C, 0xFF, 0xFF, 0xFF };
+	memcpy(sim.answer[LIDAR_REVOLUTIONS], revolutions, sizeof(revolutions));
+	sim.answerSize[LIDAR_REVOLUTIONS] = sizeof(revolutions);
+	memcpy(sim.answer[LIDAR_FORWARD_OFFSET], offset, sizeof(offset));
+	sim.answerSize[LIDAR_FORWARD_OFFSET] = sizeof(offset);
+	memcpy(sim.answer[LIDAR_TEMPRATURE], temperature, sizeof(temperature));
+	sim.answerSize[LIDAR_TEMPRATURE] = sizeof(temperature);
+	for(int i = 0; i < 16; i++) sim.answer[LIDAR_USER_DATA][i] = (uint8_t)(0xA0 + i);
+	sim.answerSize[LIDAR_USER_DATA] = 16;
+
+	sf40_t* lidar = memoryLidarStart(&sim);
+	if(lidar == NULL){
+		expect("memory lidar", false);
+		return;
+	}
+
+	expect("getRevolutions value", sf40GetRevolutions(lidar) == 0x12345678);
+	expect("getRevolutions command", atomic_load(&sim.lastCommand) == LIDAR_REVOLUTIONS);
+
+	expect("getOffset value", sf40GetOffset(lidar) == 45);
+	expect("getOffset command", atomic_load(&sim.lastCommand) == LIDAR_FORWARD_OFFSET);
+
+	expect("getTemperature value", sf40GetTemperature(lidar) == -1.0f);
+	expect("getTemperature command", atomic_load(&sim.lastCommand) == LIDAR_TEMPRATURE);
+
+	uint8_t data[17];
+	memset(data, 0x55, sizeof(data));
+	sf40GetUserData(lidar, data);
+	expect("getUserData value", memcmp(data, sim.answer[LIDAR_USER_DATA], 16) == 0);
+	expect("getUserData stays within 16 bytes", data[16] == 0x55);
+	expect("getUserData command", atomic_load(&sim.lastCommand) == LIDAR_USER_DATA);
+
+	memoryLidarStop(&sim);
+}/*checkGetters*/
+
+
+int main(void){
+	checkDecoders();
+	checkGetters();
+
+	printf("responseTest: %d failure(s)\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
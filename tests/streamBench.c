@@ -0,0 +1,279 @@
+/*!
+ *  \file    streamBench.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Read syscalls per second and cpu use of receiving a 921600 baud stream, for the chunked
+ *           ring buffer reader and for the byte by byte reading getPacket used to do
+ *
+ *  \details A child process plays a recording into a pseudo terminal at the speed of the serial port.
+ *           Pass the path of a recorded stream to use it, otherwise a stream of 200 point packets is generated.
+ */
+
+#define _GNU_SOURCE
+#include "lightwareSF40.h"
+#include "lightwareSF40CRC.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define BYTES_PER_SECOND 92160      // 921600 baud with a start and stop bit per byte
+#define RUN_SECONDS      3.0        // Time each reader is measured
+#define PACKET_POINTS    200        // Points per packet of the generated stream
+#define PACKETS          1000       // Packets in the generated stream, it is played over and over
+
+// What a reader cost over the run
+typedef struct{
+	double   seconds;       // Wall time
+	double   cpu;           // User and system time of this process
+	uint64_t reads;         // Read syscalls of this process
+	uint32_t packets;       // Stream packets received with a valid checksum
+}result_t;
+
+
+/*! \brief Current time of the monotonic clock in seconds
+ */
+static double now(void){
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+}/*now*/
+
+
+/*! \brief User and system time this process has used in seconds
+ */
+static double cpuTime(void){
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}/*cpuTime*/
+
+
+/*! \brief Read syscalls this process has made, from /proc/self/io
+ */
+static uint64_t readSyscalls(void){
+	unsigned long long reads = 0;
+	char line[128];
+	FILE* io = fopen("/proc/self/io", "r");
+	if(io == NULL) return 0;
+	while(fgets(line, sizeof(line), io) != NULL){
+		if(sscanf(line, "syscr: %llu", &reads) == 1) break;
+	}
+	fclose(io);
+	return reads;
+}/*readSyscalls*/
+
+
+/*! \brief Build a stream of distance output packets
+ *
+ *  \return size of the stream in bytes
+ */
+static size_t generateStream(uint8_t** stream){
+	size_t packetSize = 3 + 15 + PACKET_POINTS * 2 + 2;
+	uint8_t* bytes = malloc(packetSize * PACKETS);
+	if(bytes == NULL) return 0;
+
+	for(uint32_t p = 0; p < PACKETS; p++){
+		uint8_t* packet = &bytes[p * packetSize];
+		uint16_t flags = (uint16_t)((15 + PACKET_POINTS * 2) << 6);
+		uint16_t total = 1000;
+		uint16_t start = (uint16_t)((p % 5) * PACKET_POINTS);
+
+		memset(packet, 0, packetSize);
+		packet[0]  = STARTBIT;
+		packet[1]  = (uint8_t)flags;
+		packet[2]  = (uint8_t)(flags >> 8);
+		packet[3]  = LIDAR_DISTANCE_OUTPUT;
+		packet[11] = (uint8_t)(p / 5);
+		packet[12] = (uint8_t)total;
+		packet[13] = (uint8_t)(total >> 8);
+		packet[14] = (uint8_t)PACKET_POINTS;
+		packet[15] = (uint8_t)(PACKET_POINTS >> 8);
+		packet[16] = (uint8_t)start;
+		packet[17] = (uint8_t)(start >> 8);
+		for(int i = 0; i < PACKET_POINTS; i++){
+			uint16_t distance = (uint16_t)(100 + (p * 7 + i * 13) % 4000);
+			packet[18 + i * 2] = (uint8_t)distance;
+			packet[19 + i * 2] = (uint8_t)(distance >> 8);
+		}
+		uint16_t crc = createCRC(packet, packetSize - 2);
+		packet[packetSize - 2] = (uint8_t)crc;
+		packet[packetSize - 1] = (uint8_t)(crc >> 8);
+	}
+	*stream = bytes;
+	return packetSize * PACKETS;
+}/*generateStream*/
+
+
+/*! \brief Play the stream into the pseudo terminal at the speed of the serial port, until killed
+ */
+static void playStream(int master, const uint8_t* stream, size_t size){
+	double start = now();
+	uint64_t sent = 0;
+	while(true){
+		uint64_t due = (uint64_t)((now() - start) * BYTES_PER_SECOND);
+		while(sent < due){
+			size_t position = sent % size;
+			size_t chunk = due - sent;
+			if(chunk > size - position) chunk = size - position;
+
+			ssize_t written = write(master, &stream[position], chunk);
+			if(written < 0) _exit(EXIT_FAILURE);
+			sent += written;
+		}
+		usleep(1000);
+	}
+}/*playStream*/
+
+
+/*! \brief Start playing the stream in a child process
+ *
+ *  \return process id of the child
+ */
+static pid_t startPlayer(int master, const uint8_t* stream, size_t size){
+	pid_t child = fork();
+	if(child == 0) playStream(master, stream, size);
+	return child;
+}/*startPlayer*/
+
+
+/*! \brief Stop the child that plays the stream
+ */
+static void stopPlayer(pid_t child){
+	kill(child, SIGKILL);
+	waitpid(child, NULL, 0);
+}/*stopPlayer*/
+
+
+/*! \brief Read one byte, blocking, the way readByte did
+ */
+static uint8_t readPortByte(int fd){
+	uint8_t byte = 0;
+	while(read(fd, &byte, 1) != 1);
+	return byte;
+}/*readPortByte*/
+
+
+/*! \brief Receive the stream one read syscall per byte, like getPacket did before the receive ring buffer
+ */
+static result_t measureBytewise(const char* port){
+	result_t result = { 0 };
+	int fd = open(port, O_RDWR | O_NOCTTY);
+	if(fd < 0) return result;
+
+	struct termios settings;
+	tcgetattr(fd, &settings);
+	cfmakeraw(&settings);
+	settings.c_cc[VMIN]  = 1;
+	settings.c_cc[VTIME] = 0;
+	tcsetattr(fd, TCSANOW, &settings);
+
+	static uint8_t packet[MAX_RESPONSE_SIZE];
+	double start = now(), cpu = cpuTime();
+	uint64_t reads = readSyscalls();
+
+	while(now() - start < RUN_SECONDS){
+		packet[0] = readPortByte(fd);
+		if(packet[0] != STARTBIT) continue;
+		packet[1] = readPortByte(fd);
+		packet[2] = readPortByte(fd);
+
+		uint16_t length = (uint16_t)(packet[1] | packet[2] << 8) >> 6;
+		if(length < 1 || length > MAX_RESPONSE_SIZE - 5) continue;
+		for(int i = 0; i < length + 2; i++) packet[i + 3] = readPortByte(fd);
+
+		uint16_t crc = (uint16_t)(packet[length + 3] | packet[length + 4] << 8);
+		if(crc == createCRC(packet, 3 + length)) result.packets++;
+	}
+
+	result.seconds = now() - start;
+	result.cpu = cpuTime() - cpu;
+	result.reads = readSyscalls() - reads;
+	close(fd);
+	return result;
+}/*measureBytewise*/
+
+
+/*! \brief Receive the stream through the library, its stream reader thread fills the ring buffer in chunks
+ */
+static result_t measureChunked(const char* port){
+	result_t result = { 0 };
+	sf40_t* lidar = sf40SetupLidar(port, LIDAR_921K6);
+	if(lidar == NULL || sf40StartStreamReader(lidar) < 0) return result;
+
+	streamOutput_t output;
+	double start = now(), cpu = cpuTime();
+	uint64_t reads = readSyscalls();
+
+	while(now() - start < RUN_SECONDS){
+		while(sf40GetStream(lidar, &output) == 0) result.packets++;
+		usleep(5000);
+	}
+
+	result.seconds = now() - start;
+	result.cpu = cpuTime() - cpu;
+	result.reads = readSyscalls() - reads;
+	sf40StopStreamReader(lidar);
+	sf40CloseLidar(lidar);
+	return result;
+}/*measureChunked*/
+
+
+/*! \brief Print the cost of a reader
+ */
+static void report(const char* name, result_t result){
+	printf("%-12s %12.0f %8.1f %10.1f\n", name, result.reads / result.seconds, 100.0 * result.cpu / result.seconds,
+		   result.packets / result.seconds);
+}/*report*/
+
+
+int main(int argc, char** argv){
+	uint8_t* stream = NULL;
+	size_t size = 0;
+
+	if(argc > 1){
+		FILE* recording = fopen(argv[1], "rb");
+		if(recording == NULL){
+			perror(argv[1]);
+			return EXIT_FAILURE;
+		}
+		fseek(recording, 0, SEEK_END);
+		size = ftell(recording);
+		rewind(recording);
+		stream = malloc(size);
+		if(stream == NULL || fread(stream, 1, size, recording) != size) size = 0;
+		fclose(recording);
+	}
+	else size = generateStream(&stream);
+	if(size == 0) return EXIT_FAILURE;
+
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if(master < 0 || grantpt(master) < 0 || unlockpt(master) < 0){
+		perror("pseudo terminal");
+		return EXIT_FAILURE;
+	}
+	const char* port = ptsname(master);
+	int keepOpen = open(port, O_RDWR | O_NOCTTY);
+
+	printf("%-12s %12s %8s %10s\n", "reader", "reads/s", "cpu %", "packets/s");
+
+	pid_t player = startPlayer(master, stream, size);
+	report("bytewise", measureBytewise(port));
+	stopPlayer(player);
+	tcflush(keepOpen, TCIOFLUSH);
+
+	player = startPlayer(master, stream, size);
+	report("chunked", measureChunked(port));
+	stopPlayer(player);
+
+	close(keepOpen);
+	close(master);
+	free(stream);
+	return EXIT_SUCCESS;
+}
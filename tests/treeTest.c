@@ -0,0 +1,204 @@
+/*!
+ *  \file    treeTest.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Checks sf40TreeQuery and sf40TreeQueryAngles against a brute force search over every point,
+ *           for trees built from a scan and trees updated packet by packet, with ranges that pass the end of the revolution
+ */
+
+#include "lightwareSF40Tree.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUERIES 500     // Random ranges asked of every tree
+
+static int failures = 0;
+
+// Distance of every point as the tree should hold it, and whether it has been received
+typedef struct{
+	uint16_t pointTotal;
+	int16_t  forwardOffset;
+	int16_t  distances[SF40_MAX_SCAN_POINTS];
+	bool     received[SF40_MAX_SCAN_POINTS];
+}points_t;
+
+
+/*! \brief A random distance, some of them negative or the same as others
+ */
+static int16_t randomDistance(void){
+	if(rand() % 4 == 0) return -1;
+	return (int16_t)(rand() % 2 ? rand() % 5000 : rand() % 50);
+}/*randomDistance*/
+
+
+/*! \brief Closest and furthest point of the range by looking at every point in it
+ *
+ *  \param inRange true for every point that is part of the range
+ *
+ *  \retval  0 : the range holds a valid point
+ *  \retval -1 : it doesn't
+ */
+static int bruteForce(const points_t* points, const bool* inRange, sf40RangeResult_t* result){
+	int16_t closest = INT16_MAX, furthest = -1;
+	uint16_t closestIndex = 0;
+	for(uint16_t i = 0; i < points->pointTotal; i++){
+		if(!inRange[i] || !points->received[i] || points->distances[i] < 0) continue;
+		if(points->distances[i] < closest){
+			closest = points->distances[i];
+			closestIndex = i;
+		}
+		if(points->distances[i] > furthest) furthest = points->distances[i];
+	}
+	if(furthest < 0) return -1;
+
+	int32_t angle = (int32_t)((int64_t)closestIndex * 3600 / points->pointTotal) + points->forwardOffset * 10;
+	result->closestDistance  = closest;
+	result->closestIndex     = closestIndex;
+	result->angle            = (int16_t)(((angle % 3600) + 3600) % 3600);
+	result->furthestDistance = furthest;
+	return 0;
+}/*bruteForce*/
+
+
+/*! \brief Compare the answer of the tree with the brute force one
+ */
+static void compare(const char* what, const points_t* points, int found, const sf40RangeResult_t* foundResult,
+					const bool* inRange, int from, int to){
+	sf40RangeResult_t expected = { 0 };
+	int result = bruteForce(points, inRange, &expected);
+	bool ok = found == result;
+	if(ok && result == 0){
+		ok = foundResult->closestDistance == expected.closestDistance && foundResult->closestIndex == expected.closestIndex &&
+			 foundResult->angle == expected.angle && foundResult->furthestDistance == expected.furthestDistance;
+	}
+	if(!ok){
+		printf("FAIL %s: %u points, range %d to %d: %d %d@%u %d, expected %d %d@%u %d\n", what, points->pointTotal, from, to,
+			   found, foundResult->closestDistance, foundResult->closestIndex, foundResult->furthestDistance,
+			   result, expected.closestDistance, expected.closestIndex, expected.furthestDistance);
+		failures++;
+	}
+}/*compare*/
+
+
+/*! \brief Ask the tree for random ranges of points and of angles, and for the ranges around the end of the revolution
+ */
+static void checkRanges(const char* what, const sf40RangeTree_t* tree, const points_t* points){
+	static bool inRange[SF40_MAX_SCAN_POINTS];
+	uint16_t total = points->pointTotal;
+	int failed = failures;
+
+	for(int q = 0; q < QUERIES + 4 && failures == failed; q++){
+		uint16_t first = (uint16_t)(rand() % total), last = (uint16_t)(rand() % total);
+		// single points at both ends, and the ranges just around the end of the revolution
+		if(q >= QUERIES){
+			static const int ends[4][2] = { {0, 0}, {-1, -1}, {-1, 0}, {1, 0} };
+			first = (uint16_t)((ends[q - QUERIES][0] + total) % total);
+			last  = (uint16_t)((ends[q - QUERIES][1] + total) % total);
+		}
+
+		for(uint16_t i = 0; i < total; i++) inRange[i] = (first <= last) ? (i >= first && i <= last) : (i >= first || i <= last);
+		sf40RangeResult_t result = { 0 };
+		int found = sf40TreeQuery(tree, first, last, &result);
+		compare(what, points, found, &result, inRange, first, last);
+	}
+
+	// point i lies at exactly 3600 * i + 10 * pointTotal * forwardOffset in 1 / pointTotal tenths of a degree
+	for(int q = 0; q < QUERIES && failures == failed; q++){
+		int16_t from = (int16_t)(rand() % 7200 - 3600), to = (int16_t)(rand() % 7200 - 3600);
+		if(q < 8) to = (int16_t)(from + q % 2);
+		int64_t turn = 3600 * (int64_t)total;
+		int64_t span = ((((int64_t)to - from) % 3600) + 3600) % 3600 * total;
+
+		for(uint16_t i = 0; i < total; i++){
+			int64_t position = (((3600 * (int64_t)i + 10 * (int64_t)total * points->forwardOffset - (int64_t)from * total) % turn) + turn) % turn;
+			inRange[i] = position <= span;
+		}
+		sf40RangeResult_t result = { 0 };
+		int found = sf40TreeQueryAngles(tree, from, to, &result);
+		compare(what, points, found, &result, inRange, from, to);
+	}
+}/*checkRanges*/
+
+
+/*! \brief Build the tree from random scans
+ */
+static void checkBuild(uint16_t pointTotal, int16_t forwardOffset){
+	static sf40Scan_t scan;
+	static points_t points;
+	static sf40RangeTree_t tree;
+
+	memset(&scan, 0, sizeof(scan));
+	scan.pointTotal = points.pointTotal = pointTotal;
+	scan.forwardOffset = points.forwardOffset = forwardOffset;
+	for(uint16_t i = 0; i < pointTotal; i++){
+		scan.distances[i] = points.distances[i] = randomDistance();
+		points.received[i] = rand() % 10 != 0;
+		if(points.received[i]) scan.coverage[i >> 3] |= (uint8_t)(1 << (i & 7));
+	}
+
+	sf40TreeInit(&tree);
+	if(sf40TreeBuild(&tree, &scan) != 0){
+		printf("FAIL build: %u points\n", pointTotal);
+		failures++;
+		return;
+	}
+	checkRanges("build", &tree, &points);
+}/*checkBuild*/
+
+
+/*! \brief Update the tree with packets at random places of the revolution, over several revolutions
+ *
+ *  \details Every point keeps the last distance that was added for it, a new point total starts over.
+ */
+static void checkPackets(uint16_t pointTotal, uint16_t nextTotal){
+	static points_t points;
+	static sf40RangeTree_t tree;
+	static streamOutput_t packet;
+
+	sf40TreeInit(&tree);
+	memset(&points, 0, sizeof(points));
+	for(int revolution = 0; revolution < 3; revolution++){
+		uint16_t total = (revolution < 2) ? pointTotal : nextTotal;
+		if(total != points.pointTotal) memset(points.received, 0, sizeof(points.received));
+		points.pointTotal = total;
+		points.forwardOffset = (int16_t)(revolution * 45 - 10);
+
+		for(int p = 0; p < 6; p++){
+			memset(&packet, 0, sizeof(packet));
+			packet.pointTotal = total;
+			packet.forwardOffset = points.forwardOffset;
+			packet.pointCount = (uint16_t)(1 + rand() % (total < SF40_MAX_STREAM_POINTS ? total : SF40_MAX_STREAM_POINTS));
+			packet.pointStartIndex = (uint16_t)(rand() % (total - packet.pointCount + 1));
+			for(uint16_t i = 0; i < packet.pointCount; i++){
+				packet.pointDistances[i] = randomDistance();
+				points.distances[packet.pointStartIndex + i] = packet.pointDistances[i];
+				points.received[packet.pointStartIndex + i] = true;
+			}
+			if(sf40TreeAddPacket(&tree, &packet) != 0){
+				printf("FAIL packets: packet of %u points at %u\n", packet.pointCount, packet.pointStartIndex);
+				failures++;
+				return;
+			}
+			checkRanges("packets", &tree, &points);
+		}
+	}
+}/*checkPackets*/
+
+
+int main(void){
+	static const uint16_t totals[] = { 1, 2, 17, 504, 1000, 1001, 8192 };
+	srand(1);
+
+	for(size_t t = 0; t < sizeof(totals) / sizeof(totals[0]); t++){
+		checkBuild(totals[t], 0);
+		checkBuild(totals[t], -37);
+		checkBuild(totals[t], 359);
+		checkPackets(totals[t], totals[(t + 1) % (sizeof(totals) / sizeof(totals[0]))]);
+	}
+
+	printf("treeTest: %d failure(s)\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
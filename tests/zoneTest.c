@@ -0,0 +1,190 @@
+/*!
+ *  \file    zoneTest.c
+ *  \author  Julian Della Guardia
+ *  \date    16-10-2026
+ *  \version 1.0
+ *
+ *  \brief   Checks when zones are entered and left: the packet each event comes with, that a zone is entered once
+ *           while something stays in it, and that it is only left after being clear for a whole revolution
+ *
+ *  \details Revolutions of TOTAL points are fed as packets of PACKET points, packet n starts at point (n % PACKETS) * PACKET of revolution n / PACKETS.
+ */
+
+#include "lightwareSF40Zones.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TOTAL       400                 // Points in a revolution, point i lies at i * 0.9 degrees
+#define PACKET      40                  // Points in a packet
+#define PACKETS     (TOTAL / PACKET)    // Packets in a revolution
+#define FAR         500                 // Distance [cm] outside every zone
+#define WIDE_ZONE   32                  // Zone all the way around, its bit is in the second mask word
+
+static int failures = 0;
+
+// Events in the order they were called, with the packet they came with
+typedef struct{
+	int      count;
+	uint32_t zone[16];
+	bool     triggered[16];
+	int      packet[16];
+	int      current;                   // Packet that is being checked
+}events_t;
+
+
+/*! \brief Report a value that differs from the expected one
+ */
+static void expect(const char* what, bool ok){
+	if(ok) return;
+	printf("FAIL %s\n", what);
+	failures++;
+}/*expect*/
+
+
+static void recordEvent(sf40Zones_t* zones, uint32_t zone, bool triggered, void* user){
+	(void)zones;
+	events_t* events = user;
+	if(events->count < 16){
+		events->zone[events->count] = zone;
+		events->triggered[events->count] = triggered;
+		events->packet[events->count] = events->current;
+	}
+	events->count++;
+}/*recordEvent*/
+
+
+/*! \brief Check a packet of a revolution against the zones
+ *
+ *  \param distances distances of every point of the revolution
+ */
+static int32_t checkPacket(sf40Zones_t* zones, const int16_t* distances, uint16_t packet, uint32_t* mask){
+	static streamOutput_t output;
+	memset(&output, 0, sizeof(output));
+	output.pointTotal = TOTAL;
+	output.pointCount = PACKET;
+	output.pointStartIndex = packet * PACKET;
+	memcpy(output.pointDistances, &distances[packet * PACKET], PACKET * sizeof(int16_t));
+	return sf40CheckZonesPacket(zones, &output, mask);
+}/*checkPacket*/
+
+
+/*! \brief Check that the next event is the expected one
+ */
+static void expectEvent(const char* what, const events_t* events, int* next, uint32_t zone, bool triggered, int packet){
+	bool ok = *next < events->count && events->zone[*next] == zone && events->triggered[*next] == triggered &&
+			  events->packet[*next] == packet;
+	if(!ok){
+		printf("FAIL %s: expected zone %u %s at packet %d, got ", what, zone, triggered ? "entered" : "left", packet);
+		if(*next < events->count){
+			printf("zone %u %s at packet %d\n", events->zone[*next], events->triggered[*next] ? "entered" : "left",
+				   events->packet[*next]);
+		}
+		else printf("nothing\n");
+		failures++;
+	}
+	(*next)++;
+}/*expectEvent*/
+
+
+/*! \brief A sector and a polygon zone over several revolutions, with something appearing in them and going away again
+ */
+static void checkEdges(void){
+	static events_t events;
+	static int16_t distances[TOTAL];
+	sf40Zones_t* zones = sf40CreateZones(recordEvent, &events);
+
+	// zone 0 around 90 degrees, points 89 to 111, zone 1 a square around 0 degrees, zones 2 to 31 disabled
+	alarm_t sector = { .enabled = 1, .direction = 90, .width = 20, .distance = 100 };
+	expect("sector zone", sf40AddSectorZone(zones, sector) == 0);
+	const float x[4] = { 1.0f, 2.0f, 2.0f, 1.0f };
+	const float y[4] = { -0.5f, -0.5f, 0.5f, 0.5f };
+	expect("polygon zone", sf40AddPolygonZone(zones, x, y, 4) == 1);
+	alarm_t disabled = { .enabled = 0, .direction = 0, .width = 360, .distance = 10000 };
+	for(uint32_t i = 2; i < WIDE_ZONE; i++) sf40AddSectorZone(zones, disabled);
+	alarm_t wide = { .enabled = 1, .direction = 0, .width = 360, .distance = 30 };
+	expect("wide zone", sf40AddSectorZone(zones, wide) == WIDE_ZONE);
+
+	uint32_t mask[SF40_ZONE_WORDS(WIDE_ZONE + 1)];
+	int32_t inside[PACKETS * 8];
+	for(int revolution = 0; revolution < 8; revolution++){
+		for(int i = 0; i < TOTAL; i++) distances[i] = FAR;
+
+		// revolutions 1 and 2 something in the sector, 4 and 5 again with a gap of less than a revolution
+		bool sectorTaken = revolution == 1 || revolution == 2 || revolution == 4 || revolution == 5;
+		if(sectorTaken) for(int i = 98; i <= 102; i++) distances[i] = 50;
+		if(revolution == 1) for(int i = 0; i <= 2; i++) distances[i] = 150;
+		if(revolution == 7) distances[TOTAL - 1] = 20;
+
+		for(int p = 0; p < PACKETS; p++){
+			events.current = revolution * PACKETS + p;
+			inside[events.current] = checkPacket(zones, distances, (uint16_t)p, mask);
+			if(events.current == 12) expect("mask of sector and polygon", mask[0] == 1 && mask[1] == 0);
+			if(events.current == 10) expect("mask of polygon", mask[0] == 2 && mask[1] == 0);
+			if(events.current == 79) expect("mask of wide zone", mask[0] == 0 && mask[1] == 1);
+			if(events.current == 13) expect("mask cleared", mask[0] == 0 && mask[1] == 0);
+		}
+	}
+
+	// zone 0 is left once clear from packet 23 up to 32, 400 points, it comes back at 42
+	// and stays in from packet 52 on, the gap from 43 to 51 is 360 points, so it isn't left, until 62
+	int next = 0;
+	expectEvent("polygon entered", &events, &next, 1, true, 10);
+	expectEvent("sector entered", &events, &next, 0, true, 12);
+	expectEvent("polygon left after a revolution", &events, &next, 1, false, 20);
+	expectEvent("sector left after a revolution", &events, &next, 0, false, 32);
+	expectEvent("sector entered again", &events, &next, 0, true, 42);
+	expectEvent("sector left after the gap", &events, &next, 0, false, 62);
+	expectEvent("wide zone entered", &events, &next, WIDE_ZONE, true, 79);
+	expect("no other events", events.count == next);
+
+	expect("packets with zones", inside[10] == 1 && inside[12] == 1 && inside[22] == 1 && inside[52] == 1 && inside[79] == 1);
+	expect("packets without zones", inside[0] == 0 && inside[11] == 0 && inside[20] == 0 && inside[43] == 0);
+	expect("triggered", sf40ZoneTriggered(zones, WIDE_ZONE) && !sf40ZoneTriggered(zones, 0) && !sf40ZoneTriggered(zones, 2));
+	sf40FreeZones(zones);
+}/*checkEdges*/
+
+
+/*! \brief Number of zones a single point enters, with every other point invalid
+ */
+static int32_t pointInside(alarm_t sector, uint16_t index, int16_t distance){
+	static int16_t distances[TOTAL];
+	for(int i = 0; i < TOTAL; i++) distances[i] = -1;
+	distances[index] = distance;
+
+	sf40Zones_t* zones = sf40CreateZones(NULL, NULL);
+	sf40AddSectorZone(zones, sector);
+	int32_t inside = checkPacket(zones, distances, index / PACKET, NULL);
+	sf40FreeZones(zones);
+	return inside;
+}/*pointInside*/
+
+
+/*! \brief Points just inside and just outside the edges of a sector
+ */
+static void checkSector(void){
+	alarm_t sector = { .enabled = 1, .direction = 90, .width = 20, .distance = 100 };
+	expect("sector centre", pointInside(sector, 100, 50) == 1);
+	expect("sector first point", pointInside(sector, 89, 50) == 1);
+	expect("sector last point", pointInside(sector, 111, 50) == 1);
+	expect("sector before", pointInside(sector, 88, 50) == 0);
+	expect("sector after", pointInside(sector, 112, 50) == 0);
+	expect("sector near range", pointInside(sector, 100, 99) == 1);
+	expect("sector past range", pointInside(sector, 100, 101) == 0);
+	expect("sector distance 0", pointInside(sector, 100, 0) == 0);
+	expect("sector invalid", pointInside(sector, 100, -1) == 0);
+
+	alarm_t across = { .enabled = 1, .direction = 0, .width = 20, .distance = 100 };
+	expect("across 0 degrees before", pointInside(across, TOTAL - 11, 50) == 1);
+	expect("across 0 degrees after", pointInside(across, 11, 50) == 1);
+	expect("across 0 degrees outside", pointInside(across, TOTAL - 12, 50) == 0);
+}/*checkSector*/
+
+
+int main(void){
+	checkEdges();
+	checkSector();
+
+	printf("zoneTest: %d failure(s)\n", failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}